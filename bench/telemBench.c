@@ -0,0 +1,213 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Telemetry benchmark: CPU time per cycle for N observers, per-client encoding versus the shared frame.
+ *
+ *  Stand-alone program, not part of the server; no NYCe connection is needed. The per-client baseline is the
+ *  status reply onData encoded for every request before the shared frame; the shared frame is timed through
+ *  telemetry.c, which is included. Build and run on the host from this directory with
+ *
+ *      gcc -std=gnu99 -O2 -I../src -I<nyce include> telemBench.c -o telemBench
+ *      ./telemBench
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "telemetry.c"
+
+/* stand-ins for the globals and helpers of rushEmb.c that telemetry.c uses */
+SHMEM_DATA*		pShmem_data = NULL;
+size_t			g_sharedMemorySize = sizeof(SHMEM_DATA);
+char			sys_case;
+unsigned int	OLD_STAT_FLG[10];
+float			OLD_NET_CURRENT[10];
+float			LAST_VC_POS[20];
+NODE			Nodes[NODE_MAX];
+int				NodeCount = 1;
+
+int NodeReadStatus(int n, NODE_STATUS *status)
+{
+	(void)n;
+	(void)status;
+	return 0;
+}
+
+void rushMakeBuffer(char* bufferout, char* bufferin, int* pointer, int size, char flag)
+{
+	memcpy(bufferout + *pointer, "786", 3);
+	*pointer += 3;
+	memcpy(bufferout + *pointer, &flag, sizeof(char));
+	*pointer += sizeof(char);
+	memcpy(bufferout + *pointer, &size, sizeof(int));
+	*pointer += sizeof(int);
+	memcpy(bufferout + *pointer, bufferin, size);
+	*pointer += size;
+}
+
+void dyad_setUpdateTimeout(double seconds)
+{
+	(void)seconds;
+}
+
+void dyad_write(dyad_Stream *stream, const void *data, int size)
+{
+	(void)stream;
+	(void)data;
+	(void)size;
+}
+
+#define TELEM_BENCH_CYCLES		20000
+
+typedef struct telem_bench_sink
+{
+	int					size;
+	char				data[TELEM_FRAME_SIZE];
+} TELEM_BENCH_SINK;
+
+static TELEM_BENCH_SINK g_benchSinks[TELEM_MAX_SESSIONS];
+
+static void TelemBenchWrite(void *sink, const void *data, int size)
+{
+	TELEM_BENCH_SINK *benchSink = sink;
+
+	memcpy(benchSink->data, data, size);
+	benchSink->size = size;
+}
+
+static double TelemCpuTime_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ *  @brief  The status reply as onData encoded it for each request before the shared frame.
+ */
+static int TelemBenchLegacyReply(const SHMEM_DATA *shm, char *buffer)
+{
+	int pSend = 0;
+	int x;
+
+	for (x = 0; x < 10; x++)
+	{
+		if (shm->STAT_FLG[x] != OLD_STAT_FLG[x])
+		{
+			rushMakeBuffer(buffer, (char*)&shm->STAT_FLG, &pSend, sizeof(unsigned int) * 10, E_STAT_FLG);
+			memcpy(OLD_STAT_FLG, shm->STAT_FLG, sizeof(OLD_STAT_FLG));
+			break;
+		}
+	}
+
+	rushMakeBuffer(buffer, (char*)&shm->VC_POS, &pSend, sizeof(float) * 20, E_VC_POS);
+	for (x = 0; x < 10; x++)
+	{
+		if (shm->NET_CURRENT[x] != OLD_NET_CURRENT[x])
+		{
+			rushMakeBuffer(buffer, (char*)&shm->NET_CURRENT, &pSend, sizeof(float) * 10, E_NET_CURRENT);
+			memcpy(OLD_NET_CURRENT, shm->NET_CURRENT, sizeof(OLD_NET_CURRENT));
+			break;
+		}
+	}
+
+	rushMakeBuffer(buffer, &sys_case, &pSend, sizeof(char) * 1, E_SYS_CASE);
+	return pSend;
+}
+
+static void TelemBenchProducer(SHMEM_DATA *shm, int cycle)
+{
+	int x;
+
+	for (x = 0; x < 20; x++)
+	{
+		shm->VC_POS[x] += 0.001f;
+	}
+	if ((cycle & 3) == 0)
+	{
+		shm->NET_CURRENT[cycle % 10] += 1;
+	}
+	if ((cycle & 15) == 0)
+	{
+		shm->STAT_FLG[cycle % 10] ^= 0x80;
+	}
+}
+
+static void TelemBench(void)
+{
+	static const int observers[] = { 1, 10, 50 };
+	static SHMEM_DATA shm;
+	static char reply[TELEM_FRAME_SIZE];
+	SHMEM_DATA *savedShm = pShmem_data;
+	TELEM_SESSION *sessions[TELEM_MAX_SESSIONS];
+	double t0, perClient, shared;
+	unsigned int encodes;
+	int n, o, cycle, size;
+
+	pShmem_data = &shm;
+
+	for (n = 0; n < (int)(sizeof(observers) / sizeof(observers[0])); n++)
+	{
+		/* per-client encoding, as onData did before */
+		memset(&shm, 0, sizeof(shm));
+		memset(OLD_STAT_FLG, 0, sizeof(OLD_STAT_FLG));
+		memset(OLD_NET_CURRENT, 0, sizeof(OLD_NET_CURRENT));
+		sys_case = SYS_READY;
+		t0 = TelemCpuTime_us();
+		for (cycle = 0; cycle < TELEM_BENCH_CYCLES; cycle++)
+		{
+			TelemBenchProducer(&shm, cycle);
+			for (o = 0; o < observers[n]; o++)
+			{
+				size = TelemBenchLegacyReply(&shm, reply);
+				TelemBenchWrite(&g_benchSinks[o], reply, size);
+			}
+		}
+		perClient = (TelemCpuTime_us() - t0) / TELEM_BENCH_CYCLES;
+
+		/* shared frame */
+		TelemInit();
+		memset(&shm, 0, sizeof(shm));
+		for (o = 0; o < observers[n]; o++)
+		{
+			sessions[o] = TelemAttach(&g_benchSinks[o], TelemBenchWrite);
+		}
+		t0 = TelemCpuTime_us();
+		for (cycle = 0; cycle < TELEM_BENCH_CYCLES; cycle++)
+		{
+			TelemBeginCycle();
+			TelemBenchProducer(&shm, cycle);
+			for (o = 0; o < observers[n]; o++)
+			{
+				TelemSend(sessions[o]);
+			}
+		}
+		shared = (TelemCpuTime_us() - t0) / TELEM_BENCH_CYCLES;
+		encodes = TelemEncodeCount();
+
+		printf("telemetry bench: %2d observers, legacy per-client reply %8.3f us/cycle, shared frame %8.3f us/cycle (%u encodes / %d cycles)\n",
+				observers[n], perClient, shared, encodes, TELEM_BENCH_CYCLES);
+	}
+
+	TelemInit();
+	memset(OLD_STAT_FLG, 0, sizeof(OLD_STAT_FLG));
+	memset(OLD_NET_CURRENT, 0, sizeof(OLD_NET_CURRENT));
+	memset(LAST_VC_POS, 0, sizeof(LAST_VC_POS));
+	pShmem_data = savedShm;
+}
+
+int main(void)
+{
+	TelemBench();
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Armed moves, see armedMove.h.
+ *
+ *  ArmLoad runs on the reactor and leaves the request in the upload slot of the axis; the control thread
+ *  takes it over in ArmPoll, which then owns the armed commands alone.
+ */
+
+#include <string.h>
+
+#include "rushEmb.h"
+#include "armedMove.h"
+#include "axisRegistry.h"
+#include "profile.h"
+#include "node.h"
+#include "handoff.h"
+#include "monotonic.h"
+
+static ARM_REQ				g_upload[AXIS_MAX];		// reactor, under g_handoff
+static HANDOFF				g_handoff = HANDOFF_INITIALIZER;
+
+static ARM_REQ				g_armed[AXIS_MAX];		// control thread
+static AXIS_MASK			g_active = 0;
+static AXIS_MASK			g_seenFalse = 0;		// condition read false since the command was armed
+
+
+/**
+ *  @brief  Check a request and store it for its axis, taken over in the next control cycle. Reactor thread.
+ *
+ *  @return 0 when the command or the trigger is invalid.
+ */
+int ArmLoad(const ARM_REQ *req)
+{
+	int ax = req->cmd.axis;
+	int source = (req->source < 0) ? ax : req->source;
+
+	if (ax < 0 || ax >= AxisCount || source >= AxisCount
+		|| AXIS_CMD_OPCODE(&req->cmd) >= OP_COUNT || AXIS_CMD_PROFILE(&req->cmd) >= PROFILE_COUNT
+		|| req->trigger < ARM_NONE || req->trigger > ARM_ON_CURRENT_BELOW)
+	{
+		return 0;
+	}
+
+	//the conditions are read from the shared memory of the source axis
+	if (req->trigger > ARM_AT_TIME && !AxisHasUdsx(source))
+	{
+		return 0;
+	}
+
+	HandoffLock(&g_handoff);
+	g_upload[ax] = *req;
+	g_upload[ax].source = source;
+	HandoffPost(&g_handoff, ax);
+	return 1;
+}
+
+/**
+ *  @brief  Disarm every axis at the start of the next control cycle.
+ */
+void ArmClearAll(void)
+{
+	HandoffClear(&g_handoff);
+}
+
+/**
+ *  @brief  The trigger condition of an armed command holds.
+ */
+static int ArmTriggered(const ARM_REQ *arm, uint64_t now)
+{
+	SHMEM_DATA *shm;
+
+	if (arm->trigger == ARM_AT_TIME)
+	{
+		return now >= arm->deadline_ns;
+	}
+
+	shm = NodeShmOfAxis(arm->source);
+	if (shm == NULL)
+	{
+		return 0;
+	}
+
+	switch (arm->trigger)
+	{
+		case ARM_ON_STAT_FLG:
+			return (__atomic_load_n(&shm->STAT_FLG[arm->source % AXIS_LEGACY_COUNT], __ATOMIC_ACQUIRE) & arm->mask) == arm->value;
+		case ARM_ON_CURRENT_ABOVE:
+			return shm->NET_CURRENT[arm->source % AXIS_LEGACY_COUNT] >= arm->threshold;
+		case ARM_ON_CURRENT_BELOW:
+			return shm->NET_CURRENT[arm->source % AXIS_LEGACY_COUNT] <= arm->threshold;
+	}
+	return 0;
+}
+
+/**
+ *  @brief  Take the new requests over and queue the armed commands whose trigger fired. Control thread,
+ *          before the paths and the AxisCmdQueue are executed.
+ */
+void ArmPoll(void)
+{
+	int ax;
+	AXIS_MASK uploads;
+	uint64_t now;
+	ARM_REQ *arm;
+
+	if (HandoffCleared(&g_handoff))
+	{
+		g_active = 0;
+	}
+
+	uploads = HandoffTake(&g_handoff);
+	if (uploads)
+	{
+		for (ax = 0; ax < AxisCount; ax++)
+		{
+			if (!(uploads & AXIS_BIT(ax)))
+			{
+				continue;
+			}
+			g_armed[ax] = g_upload[ax];
+			g_active &= ~AXIS_BIT(ax);
+			g_seenFalse &= ~AXIS_BIT(ax);
+			if (g_armed[ax].trigger == ARM_NONE)
+			{
+				continue;
+			}
+			if (AxisHandler[ax][AXIS_CMD_OPCODE(&g_armed[ax].cmd)] == NULL)
+			{
+				logging(ax,(float)g_armed[ax].cmd.opcode,"armed command not supported by the axis","ArmPoll");  ////////////////log
+				continue;
+			}
+			g_active |= AXIS_BIT(ax);
+		}
+		HandoffRelease(&g_handoff);
+	}
+
+	if (g_active == 0)
+	{
+		return;
+	}
+
+	now = MonotonicNs();
+
+	for (ax = 0; ax < AxisCount && g_active; ax++)
+	{
+		arm = &g_armed[ax];
+		if (!(g_active & AXIS_BIT(ax)))
+		{
+			continue;
+		}
+
+		if (arm->expire_ns && now >= arm->expire_ns)
+		{
+			g_active &= ~AXIS_BIT(ax);
+			logging(ax,(float)arm->trigger,"armed command expired","ArmPoll");  ////////////////log
+			continue;
+		}
+
+		if (AxisCmdCount >= AXIS_CMD_QUEUE)
+		{
+			break;
+		}
+
+		//a condition fires on its edge: it has to be read false once after arming, a deadline fires when reached
+		if (!ArmTriggered(arm, now))
+		{
+			g_seenFalse |= AXIS_BIT(ax);
+			continue;
+		}
+
+		if (SacConnected[ax] == 255 && (arm->trigger == ARM_AT_TIME || (g_seenFalse & AXIS_BIT(ax))))
+		{
+			AxisCmdQueue[AxisCmdCount++] = arm->cmd;
+			g_active &= ~AXIS_BIT(ax);
+		}
+	}
+}
@@ -0,0 +1,65 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Armed moves: axis commands sent ahead and started by the control thread on a trigger.
+ *
+ *  Instead of waiting for a machine event and then sending the command, the host arms it with E_AXIS_ARM
+ *  (payload ARM_REQ). The command is checked when it is armed and then waits on the box until its trigger:
+ *
+ *      ARM_AT_TIME         CLOCK_MONOTONIC of the box reaches deadline_ns, the clock of MOVE_EVENT timestamps
+ *      ARM_ON_STAT_FLG     (STAT_FLG & mask) becomes value for the source axis
+ *      ARM_ON_CURRENT_ABOVE, ARM_ON_CURRENT_BELOW
+ *                          NET_CURRENT of the source axis crosses threshold
+ *
+ *  The conditions are read from the shared memory of the node of the source axis every control cycle and
+ *  are edge triggered: a condition that already holds when the command is armed has to be read false once
+ *  before it fires, so a flag or a current left over from the last machine cycle does not start the move
+ *  early. A command that fires is queued ahead of the paths and the auto-tuner in that same cycle, so it is
+ *  planned and started within one control cycle of its trigger, and reported by the move events like any
+ *  other.
+ *
+ *  One command is armed per axis, arming again replaces it and ARM_NONE disarms. A command fires once; it is
+ *  dropped when expire_ns passes first, or by a system stop. Host commands for the axis do not disarm it.
+ */
+
+#ifndef _RUSH_ARMED_MOVE_H_
+#define _RUSH_ARMED_MOVE_H_
+
+#include <stdint.h>
+#include "rushEmb.h"
+
+/* ARM_REQ triggers */
+#define ARM_NONE				0
+#define ARM_AT_TIME				1
+#define ARM_ON_STAT_FLG			2
+#define ARM_ON_CURRENT_ABOVE	3
+#define ARM_ON_CURRENT_BELOW	4
+
+/**
+ * @brief   E_AXIS_ARM request.
+ */
+typedef struct arm_req
+{
+	AXIS_CMD			cmd;				/**< The command, for cmd.axis */
+	int32_t				trigger;			/**< ARM_NONE ... ARM_ON_CURRENT_BELOW */
+	int32_t				source;				/**< Axis whose shared memory is watched, -1 for cmd.axis */
+	uint32_t			mask;				/**< ARM_ON_STAT_FLG */
+	uint32_t			value;
+	float				threshold;			/**< ARM_ON_CURRENT_ABOVE/BELOW */
+	uint64_t			deadline_ns;		/**< ARM_AT_TIME, in the past fires at once */
+	uint64_t			expire_ns;			/**< Dropped unfired after it, 0 for never */
+} ARM_REQ;
+
+int ArmLoad(const ARM_REQ *req);
+void ArmClearAll(void);
+void ArmPoll(void);
+
+#endif
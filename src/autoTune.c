@@ -0,0 +1,481 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Auto-tuner, see autoTune.h.
+ *
+ *  TuneRequest runs on the reactor, TunePoll on the control thread, TuneLoad, TuneApplySaved and TuneReport
+ *  on the main thread, which alone touches TUNE_FILE. They share the results and the saved table under
+ *  g_tuneLock; a request is handed over in the upload slot of g_handoff. The sweep itself is control thread
+ *  state, its results are published by TunePublish, which never waits for g_tuneLock.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "rushEmb.h"
+#include "autoTune.h"
+#include "axisStats.h"
+#include "profile.h"
+#include "hostState.h"
+#include "handoff.h"
+#include "monotonic.h"
+
+typedef struct tune_saved
+{
+	char				name[AXIS_NAME_LEN];
+	float				distance;
+	float				duration;
+} TUNE_SAVED;
+
+typedef struct tune_sweep
+{
+	int					running;
+	TUNE_REQ			req;
+	double				base;				/**< Start position of an absolute axis */
+	int					relative;
+	float				candidate;			/**< Duration of the current step */
+	int					move;				/**< Moves issued in the current step, out and back */
+	int					waiting;			/**< A move is out, its statistics not yet in */
+	uint32_t			moves;				/**< AXIS_STATS.moves when it was issued */
+	uint32_t			failures;
+	uint64_t			issued_ns;
+	float				overshoot;			/**< Largest of the current step */
+	float				settle;
+} TUNE_SWEEP;
+
+static pthread_mutex_t		g_tuneLock = PTHREAD_MUTEX_INITIALIZER;
+static TUNE_REQ				g_pending;				// reactor, under g_handoff
+static HANDOFF				g_handoff = HANDOFF_INITIALIZER;
+static TUNE_RESULT			g_results[AXIS_MAX];	// under g_tuneLock
+static TUNE_SAVED			g_saved[AXIS_MAX];		// under g_tuneLock
+static int					g_savedCount = 0;
+static int					g_dirty = 0;			// g_saved changed, written by TuneReport
+
+static TUNE_SWEEP			g_sweep;				// control thread
+static TUNE_RESULT			g_local[AXIS_MAX];		// control thread, published to g_results
+static AXIS_MASK			g_changed = 0;			// control thread, g_local not yet published
+static AXIS_MASK			g_save = 0;				// control thread, results TunePublish adds to g_saved
+
+
+static int TuneFindSaved(const char *name)
+{
+	int i;
+
+	for (i = 0; i < g_savedCount; i++)
+	{
+		if (strcmp(g_saved[i].name, name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ *  @brief  Read TUNE_FILE, lines "name<TAB>distance<TAB>duration". Main thread, at startup.
+ */
+void TuneLoad(void)
+{
+	FILE *file = fopen(TUNE_FILE, "r");
+	char line[100];
+	TUNE_SAVED entry;
+
+	if (file == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&g_tuneLock);
+	while (g_savedCount < AXIS_MAX && fgets(line, sizeof(line), file))
+	{
+		if (sscanf(line, "%19[^\t]\t%f\t%f", entry.name, &entry.distance, &entry.duration) == 3
+			&& entry.distance > 0 && entry.duration > 0 && TuneFindSaved(entry.name) < 0)
+		{
+			g_saved[g_savedCount++] = entry;
+		}
+	}
+	pthread_mutex_unlock(&g_tuneLock);
+
+	fclose(file);
+	printf("auto tune: %d saved axes\n", g_savedCount);
+}
+
+/**
+ *  @brief  Give an axis the defaults saved for its name. AxisInit, after AxisResetParams.
+ */
+void TuneApplySaved(int ax)
+{
+	int i;
+
+	pthread_mutex_lock(&g_tuneLock);
+	i = TuneFindSaved(Axis_Name[ax]);
+	if (i >= 0)
+	{
+		AxisSetParam(ax, AXIS_PAR_DEF_DISTANCE, g_saved[i].distance);
+		AxisSetParam(ax, AXIS_PAR_DEF_DURATION, g_saved[i].duration);
+	}
+	pthread_mutex_unlock(&g_tuneLock);
+}
+
+/**
+ *  @brief  Hand a request to the control thread and report the last result of its axis. Reactor thread.
+ *
+ *  @return 0 when the request is invalid.
+ */
+int TuneRequest(const TUNE_REQ *req, TUNE_RESULT *result)
+{
+	int ax, busy = 0;
+
+	if (req->axis < 0 || req->axis >= AxisCount
+		|| ((req->flags & TUNE_START) && (req->distance <= 0 || req->overshoot < 0 || req->settle <= 0)))
+	{
+		return 0;
+	}
+
+	pthread_mutex_lock(&g_tuneLock);
+	for (ax = 0; ax < AxisCount && (req->flags & TUNE_START); ax++)
+	{
+		if (g_results[ax].state == TUNE_RUNNING)
+		{
+			logging(req->axis,(float)ax,"auto tune busy with axis","TuneRequest");  ////////////////log
+			busy = 1;
+			break;
+		}
+	}
+	*result = g_results[req->axis];
+	result->axis = req->axis;
+	pthread_mutex_unlock(&g_tuneLock);
+
+	if (!busy && (req->flags & (TUNE_START | TUNE_ABORT)))
+	{
+		HandoffLock(&g_handoff);
+		g_pending = *req;
+		HandoffPost(&g_handoff, 0);
+	}
+	return 1;
+}
+
+/**
+ *  @brief  Abort the sweep at the start of the next control cycle, on a system stop.
+ */
+void TuneClearAll(void)
+{
+	HandoffClear(&g_handoff);
+}
+
+static void TuneSetResult(int state, float duration, float overshoot, float settle, int steps)
+{
+	TUNE_RESULT *result = &g_local[g_sweep.req.axis];
+
+	result->axis = g_sweep.req.axis;
+	result->state = state;
+	result->distance = g_sweep.req.distance;
+	if (steps >= 0)
+	{
+		result->steps = steps;
+		result->duration = duration;
+		result->overshoot = overshoot;
+		result->settle = settle;
+	}
+	g_changed |= AXIS_BIT(g_sweep.req.axis);
+}
+
+/**
+ *  @brief  End the sweep; a result within the budgets is applied and saved when the request asked for it.
+ */
+static void TuneFinish(int state)
+{
+	int ax = g_sweep.req.axis;
+	TUNE_RESULT result = g_local[ax];
+
+	g_sweep.running = 0;
+
+	if (state == TUNE_DONE && result.duration <= 0)
+	{
+		state = TUNE_FAILED;
+	}
+	TuneSetResult(state, 0, 0, 0, -1);
+	logging(ax,result.duration,(state == TUNE_DONE) ? "auto tune done, duration" : "auto tune stopped","TuneFinish");  ////////////////log
+
+	if (state != TUNE_DONE || !(g_sweep.req.flags & TUNE_APPLY))
+	{
+		return;
+	}
+
+	AxisSetParam(ax, AXIS_PAR_DEF_DISTANCE, result.distance);
+	AxisSetParam(ax, AXIS_PAR_DEF_DURATION, result.duration);
+
+	if (g_sweep.req.flags & TUNE_PERSIST)
+	{
+		g_save |= AXIS_BIT(ax);
+	}
+}
+
+/**
+ *  @brief  Copy the changed results to g_results and the results to be saved to g_saved.
+ */
+static void TunePublish(void)
+{
+	int ax, i, saved = 0;
+
+	//the reactor and the main thread only hold g_tuneLock for a copy, a busy lock is retried in the next cycle
+	if (g_changed == 0 || pthread_mutex_trylock(&g_tuneLock) != 0)
+	{
+		return;
+	}
+
+	for (ax = 0; ax < AxisCount; ax++)
+	{
+		if (!(g_changed & AXIS_BIT(ax)))
+		{
+			continue;
+		}
+		g_results[ax] = g_local[ax];
+
+		if (!(g_save & AXIS_BIT(ax)))
+		{
+			continue;
+		}
+		i = TuneFindSaved(Axis_Name[ax]);
+		if (i < 0 && g_savedCount < AXIS_MAX)
+		{
+			i = g_savedCount++;
+			strcpy(g_saved[i].name, Axis_Name[ax]);
+		}
+		if (i >= 0)
+		{
+			g_saved[i].distance = g_local[ax].distance;
+			g_saved[i].duration = g_local[ax].duration;
+			g_dirty = 1;
+			saved = 1;
+		}
+	}
+	pthread_mutex_unlock(&g_tuneLock);
+
+	g_changed = 0;
+	g_save = 0;
+	if (saved)
+	{
+		HostPostEvent();
+	}
+}
+
+static void TuneBegin(const TUNE_REQ *req)
+{
+	int ax = req->axis;
+	float defDistance = AxisParam[AXIS_PAR_DEF_DISTANCE][ax];
+	float defDuration = AxisParam[AXIS_PAR_DEF_DURATION][ax];
+	AXIS_STATS stats;
+
+	memset(&g_sweep, 0, sizeof(g_sweep));
+	g_sweep.req = *req;
+	g_sweep.running = 1;
+	TuneSetResult(TUNE_RUNNING, 0, 0, 0, 0);
+
+	if (!AxisHasUdsx(ax) || SacConnected[ax] != 255 || AxisHandler[ax][OP_MOVE] == NULL)
+	{
+		TuneFinish(TUNE_FAILED);				//no feedback, or the axis cannot move
+		return;
+	}
+
+	//the duration the current defaults give the sweep distance, as ProfilePrepare computes it
+	g_sweep.candidate = (defDistance > 0) ? defDuration * req->distance / defDistance : defDuration;
+	if (g_sweep.candidate < defDuration)
+	{
+		g_sweep.candidate = defDuration;
+	}
+
+	g_sweep.relative = (Axis_Type[ax] == STD_REL) || (Axis_Type[ax] == TURRET && AxisParam[AXIS_PAR_ABSOLUTE][ax] == 0);
+	g_sweep.base = ProfileSetPoint(ax);
+
+	AxisStatsRead(ax, &stats);
+	g_sweep.failures = stats.failures;
+	logging(ax,req->distance,"auto tune start, distance","TuneBegin");  ////////////////log
+}
+
+/**
+ *  @brief  Queue the next move of the sweep, out to the sweep distance or back.
+ */
+static void TuneIssue(void)
+{
+	int ax = g_sweep.req.axis;
+	float step = (g_sweep.move == 0) ? g_sweep.req.distance : -g_sweep.req.distance;
+	AXIS_CMD *cmd = &AxisCmdQueue[AxisCmdCount++];
+	AXIS_STATS stats;
+
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->axis = ax;
+	cmd->opcode = OP_MOVE;
+	cmd->position = g_sweep.relative ? step : g_sweep.base + ((g_sweep.move == 0) ? g_sweep.req.distance : 0);
+	cmd->distance = g_sweep.req.distance;
+	cmd->duration = g_sweep.candidate;
+
+	AxisStatsRead(ax, &stats);
+	g_sweep.moves = stats.moves;
+	g_sweep.waiting = 1;
+	g_sweep.move++;
+	g_sweep.issued_ns = MonotonicNs();
+}
+
+/**
+ *  @brief  Take new requests over.
+ */
+static void TuneTakeRequests(void)
+{
+	TUNE_REQ req;
+
+	if (HandoffCleared(&g_handoff) && g_sweep.running)
+	{
+		TuneFinish(TUNE_ABORTED);
+	}
+
+	if (HandoffTake(&g_handoff))
+	{
+		req = g_pending;
+		HandoffRelease(&g_handoff);
+
+		if ((req.flags & TUNE_ABORT) && g_sweep.running && req.axis == g_sweep.req.axis)
+		{
+			TuneFinish(TUNE_ABORTED);
+		}
+		else if ((req.flags & TUNE_START) && g_sweep.running)
+		{
+			logging(req.axis,(float)g_sweep.req.axis,"auto tune busy with axis","TunePoll");  ////////////////log
+		}
+		else if (req.flags & TUNE_START)
+		{
+			TuneBegin(&req);
+		}
+	}
+}
+
+/**
+ *  @brief  Advance the sweep to its next move once the statistics of the last one are in.
+ */
+static void TuneStep(void)
+{
+	int ax, steps;
+	AXIS_STATS stats;
+
+	if (!g_sweep.running)
+	{
+		return;
+	}
+	ax = g_sweep.req.axis;
+
+	AxisStatsRead(ax, &stats);
+	if (SacConnected[ax] != 255 || stats.failures != g_sweep.failures)
+	{
+		TuneFinish(TUNE_FAILED);
+		return;
+	}
+
+	//the host took the axis back
+	if (AxisCmdQueued() & AXIS_BIT(ax))
+	{
+		TuneFinish(TUNE_ABORTED);
+		return;
+	}
+
+	if (g_sweep.waiting)
+	{
+		if (stats.moves == g_sweep.moves)
+		{
+			if (MonotonicSince(g_sweep.issued_ns) / 1e9 > g_sweep.candidate + AXIS_STATS_SETTLE_MS / 1000.0 + TUNE_MOVE_TIMEOUT_S)
+			{
+				TuneFinish(TUNE_FAILED);			//never in position
+			}
+			return;
+		}
+
+		g_sweep.waiting = 0;
+		if (stats.overshoot.last > g_sweep.overshoot)
+		{
+			g_sweep.overshoot = stats.overshoot.last;
+		}
+		if (stats.settle.last > g_sweep.settle)
+		{
+			g_sweep.settle = stats.settle.last;
+		}
+	}
+
+	if (g_sweep.move == 2)
+	{
+		if (g_sweep.overshoot > g_sweep.req.overshoot || g_sweep.settle > g_sweep.req.settle)
+		{
+			TuneFinish(TUNE_DONE);
+			return;
+		}
+
+		steps = g_local[ax].steps + 1;
+		TuneSetResult(TUNE_RUNNING, g_sweep.candidate, g_sweep.overshoot, g_sweep.settle, steps);
+
+		if (steps >= TUNE_MAX_STEPS)
+		{
+			TuneFinish(TUNE_DONE);
+			return;
+		}
+
+		g_sweep.candidate *= TUNE_STEP_FACTOR;
+		g_sweep.move = 0;
+		g_sweep.overshoot = g_sweep.settle = 0;
+	}
+
+	if (AxisCmdCount < AXIS_CMD_QUEUE)
+	{
+		TuneIssue();
+	}
+}
+
+/**
+ *  @brief  Take new requests over, advance the sweep and publish its results. Control thread, before the
+ *          AxisCmdQueue is executed.
+ */
+void TunePoll(void)
+{
+	TuneTakeRequests();
+	TuneStep();
+	TunePublish();
+}
+
+/**
+ *  @brief  Write TUNE_FILE when a sweep saved a result. Main thread, keeps file I/O off the control thread.
+ */
+void TuneReport(void)
+{
+	FILE *file;
+	TUNE_SAVED saved[AXIS_MAX];
+	int i, count;
+
+	pthread_mutex_lock(&g_tuneLock);
+	if (!g_dirty)
+	{
+		pthread_mutex_unlock(&g_tuneLock);
+		return;
+	}
+	g_dirty = 0;
+	count = g_savedCount;
+	memcpy(saved, g_saved, count * sizeof(TUNE_SAVED));
+	pthread_mutex_unlock(&g_tuneLock);
+
+	file = fopen(TUNE_FILE, "w");
+	if (file == NULL)
+	{
+		logging(100,0,"cannot write auto tune file","TuneReport");  ////////////////log
+		return;
+	}
+	for (i = 0; i < count; i++)
+	{
+		fprintf(file, "%s\t%g\t%g\n", saved[i].name, saved[i].distance, saved[i].duration);
+	}
+	fclose(file);
+}
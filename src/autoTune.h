@@ -0,0 +1,87 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Auto-tuner of the default distance and duration of an axis (AXIS_PAR_DEF_DISTANCE/DURATION).
+ *
+ *  Opt-in with E_AXIS_TUNE (payload TUNE_REQ, reply TUNE_RESULT). TUNE_START runs a characterization sweep
+ *  on one axis: moves over the requested distance, out and back, first with the duration the current
+ *  defaults give that distance, then TUNE_STEP_FACTOR shorter each step. Overshoot and settle time of every
+ *  move are taken from the axis statistics (axisStats.h), so the axis needs a UDSX. The sweep ends at the
+ *  first step exceeding the overshoot or settle budget, after TUNE_MAX_STEPS steps, or when the axis is
+ *  disconnected, refuses a move, gets a host command or the system stops. The result is the shortest
+ *  duration whose moves stayed within both budgets.
+ *
+ *  Without TUNE_APPLY the result is only a suggestion, reported in TUNE_RESULT. TUNE_APPLY makes it the
+ *  defaults of the axis; with TUNE_PERSIST it is also saved to TUNE_FILE, keyed by axis name, and applied
+ *  again by every init after AxisResetParams.
+ *
+ *  One sweep runs at a time, a TUNE_START for another axis is refused while it runs. A request without
+ *  TUNE_START only reports the last result of the axis; TUNE_ABORT stops its sweep.
+ */
+
+#ifndef _RUSH_AUTO_TUNE_H_
+#define _RUSH_AUTO_TUNE_H_
+
+#include "rushEmb.h"
+#include "axisRegistry.h"
+
+#define TUNE_FILE				"/home/user/rushTune.cfg"
+#define TUNE_STEP_FACTOR		0.8f
+#define TUNE_MAX_STEPS			12
+#define TUNE_MOVE_TIMEOUT_S		2.0		/* beyond the duration of a move, for its statistics */
+
+/* TUNE_REQ flags */
+#define TUNE_START				0x01
+#define TUNE_APPLY				0x02
+#define TUNE_PERSIST			0x04
+#define TUNE_ABORT				0x08
+
+/* TUNE_RESULT states */
+#define TUNE_IDLE				0
+#define TUNE_RUNNING			1
+#define TUNE_DONE				2
+#define TUNE_FAILED				3		/* no duration met the budgets, or the axis could not move */
+#define TUNE_ABORTED			4
+
+/**
+ * @brief   E_AXIS_TUNE request.
+ */
+typedef struct tune_req
+{
+	int					axis;
+	int					flags;				/**< TUNE_START, TUNE_APPLY, TUNE_PERSIST, TUNE_ABORT */
+	float				distance;			/**< Sweep distance, > 0 */
+	float				overshoot;			/**< Overshoot budget, axis units */
+	float				settle;				/**< Settle time budget, seconds */
+} TUNE_REQ;
+
+/**
+ * @brief   E_AXIS_TUNE reply, the last sweep of an axis.
+ */
+typedef struct tune_result
+{
+	int					axis;
+	int					state;				/**< TUNE_IDLE ... TUNE_ABORTED */
+	int					steps;				/**< Steps within the budgets */
+	float				distance;
+	float				duration;			/**< Shortest duration within the budgets, 0 for none */
+	float				overshoot;			/**< Largest overshoot at that duration */
+	float				settle;				/**< Largest settle time at that duration */
+} TUNE_RESULT;
+
+void TuneLoad(void);
+void TuneApplySaved(int ax);
+int TuneRequest(const TUNE_REQ *req, TUNE_RESULT *result);
+void TuneClearAll(void);
+void TunePoll(void);
+void TuneReport(void);
+
+#endif
@@ -0,0 +1,325 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Axis registry, see axisRegistry.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "rushEmb.h"
+#include "hostState.h"
+#include "axisRegistry.h"
+#include "node.h"
+
+#define AXIS_REG_ERR_NO_MEMORY		USR_ERROR(114)
+
+/**
+ * @brief   One per-axis array, allocated with AxisCount elements.
+ */
+typedef struct axis_field
+{
+	void**				array;
+	size_t				elementSize;
+} AXIS_FIELD;
+
+int AxisCount = AXIS_LEGACY_COUNT;
+float *AxisParam[AXIS_PAR_COUNT];
+
+/* per-axis state of rushEmb.h */
+NYCE_STATUS *StatusSDisconnect;
+NYCE_STATUS *StatusSConnect;
+NYCE_STATUS *StatusPtp;
+NYCE_STATUS *StatusOpenLoop;
+NYCE_STATUS *StatusLock;
+NYCE_STATUS *StatusWParameter;
+
+AXIS_HANDLER (*AxisHandler)[OP_COUNT];
+
+float *oldCmdPos;
+float *oldPtpPos;
+
+int *Axis_Type;
+char (*Axis_Name)[20];
+int *SacConnected;
+int *SacMovedCnt;
+int *Cmd_Toggle;
+char (*ConnectedName)[20];
+int *ConnectedType;
+
+double *distance;
+double *duration;
+double *ratio;
+
+SAC_AXIS *sacAxis;
+SAC_PTP_PARS *m_sacPtpPars;
+
+float *STANDBY_POS;
+
+/* registry only */
+static unsigned int *g_statFlag;			// status flags of the axes without shared memory
+static char (*g_defName)[AXIS_NAME_LEN];	// E_AXIS_DEF, read by the next init
+static int *g_defType;
+static pthread_mutex_t g_defLock = PTHREAD_MUTEX_INITIALIZER;
+
+#define AXIS_FIELD_OF(array)	{ (void**)&(array), sizeof(*(array)) }
+#define AXIS_PARAM_FIELD(id, ctrBase, reset, def, turretDef)		{ (void**)&AxisParam[id], sizeof(float) },
+
+static const AXIS_FIELD g_fields[] =
+{
+	AXIS_FIELD_OF(StatusSDisconnect),
+	AXIS_FIELD_OF(StatusSConnect),
+	AXIS_FIELD_OF(StatusPtp),
+	AXIS_FIELD_OF(StatusOpenLoop),
+	AXIS_FIELD_OF(StatusLock),
+	AXIS_FIELD_OF(StatusWParameter),
+	AXIS_FIELD_OF(AxisHandler),
+	AXIS_FIELD_OF(oldCmdPos),
+	AXIS_FIELD_OF(oldPtpPos),
+	AXIS_FIELD_OF(Axis_Type),
+	AXIS_FIELD_OF(Axis_Name),
+	AXIS_FIELD_OF(SacConnected),
+	AXIS_FIELD_OF(SacMovedCnt),
+	AXIS_FIELD_OF(Cmd_Toggle),
+	AXIS_FIELD_OF(ConnectedName),
+	AXIS_FIELD_OF(ConnectedType),
+	AXIS_FIELD_OF(distance),
+	AXIS_FIELD_OF(duration),
+	AXIS_FIELD_OF(ratio),
+	AXIS_FIELD_OF(sacAxis),
+	AXIS_FIELD_OF(m_sacPtpPars),
+	AXIS_FIELD_OF(g_statFlag),
+	AXIS_FIELD_OF(g_defName),
+	AXIS_FIELD_OF(g_defType),
+	AXIS_PARAM_LIST(AXIS_PARAM_FIELD)
+};
+
+#define AXIS_FIELD_COUNT	(int)(sizeof(g_fields) / sizeof(g_fields[0]))
+
+/* columns of AXIS_PARAM_LIST */
+#define AXIS_PARAM_CTR(id, ctrBase, reset, def, turretDef)			ctrBase,
+#define AXIS_PARAM_RESET(id, ctrBase, reset, def, turretDef)		reset,
+#define AXIS_PARAM_DEFAULT(id, ctrBase, reset, def, turretDef)		def,
+#define AXIS_PARAM_TURRET(id, ctrBase, reset, def, turretDef)		turretDef,
+
+static const int g_paramCtrBase[AXIS_PAR_COUNT] = { AXIS_PARAM_LIST(AXIS_PARAM_CTR) };
+static const int g_paramReset[AXIS_PAR_COUNT] = { AXIS_PARAM_LIST(AXIS_PARAM_RESET) };
+static const float g_paramDefault[AXIS_PAR_COUNT] = { AXIS_PARAM_LIST(AXIS_PARAM_DEFAULT) };
+static const float g_paramTurret[AXIS_PAR_COUNT] = { AXIS_PARAM_LIST(AXIS_PARAM_TURRET) };
+
+
+/**
+ *  @brief  Size the registry and allocate every per-axis array. Called once, before any thread uses an axis.
+ */
+NYCE_STATUS AxisRegistryInit(int defaultCount)
+{
+	int ax, i, count = defaultCount;
+	const char *env = getenv(AXIS_COUNT_ENV);
+
+	if (env)
+	{
+		count = atoi(env);
+		if (count < 1 || count > AXIS_MAX)
+		{
+			logging(100,(float)count,"invalid axis count, using default",AXIS_COUNT_ENV);  ////////////////log
+			count = defaultCount;
+		}
+	}
+	AxisCount = count;
+
+	for (i = 0; i < AXIS_FIELD_COUNT; i++)
+	{
+		*g_fields[i].array = calloc(count, g_fields[i].elementSize);
+		if (*g_fields[i].array == NULL)
+		{
+			return AXIS_REG_ERR_NO_MEMORY;
+		}
+	}
+
+	STANDBY_POS = AxisParam[AXIS_PAR_STANDBY_POS];
+
+	for (ax = 0; ax < count; ax++)
+	{
+		Axis_Type[ax] = NA;
+		strcpy(Axis_Name[ax], "NA");
+		g_defType[ax] = NA;
+		g_statFlag[ax] = 0x01;
+	}
+
+	printf("axis registry: %d axes\n", count);
+	return NYCE_OK;
+}
+
+/**
+ *  @brief  CTR_FLG index a parameter of an axis is mirrored to.
+ *
+ *  @return -1 when the axis is not a legacy axis.
+ */
+int AxisCtrIndex(int param, int ax)
+{
+	if (param < 0 || param >= AXIS_PAR_COUNT || ax < 0 || ax >= AXIS_LEGACY_COUNT || ax >= AxisCount || g_paramCtrBase[param] < 0)
+	{
+		return -1;
+	}
+	return g_paramCtrBase[param] + ax;
+}
+
+/**
+ *  @brief  Take the parameters of the legacy axes over from a CTR_FLG copy. Control thread.
+ */
+void AxisParamsFromCtr(const float *ctr)
+{
+	int param, ax;
+
+	for (param = 0; param < AXIS_PAR_COUNT; param++)
+	{
+		for (ax = 0; ax < AXIS_LEGACY_COUNT && ax < AxisCount && g_paramCtrBase[param] >= 0; ax++)
+		{
+			AxisParam[param][ax] = ctr[g_paramCtrBase[param] + ax];
+		}
+	}
+}
+
+/**
+ *  @brief  Write the parameters of AXIS_LEGACY_COUNT axes from firstAxis into a CTR_FLG layout, the
+ *          Shared_CtrFlag of the node owning them.
+ */
+void AxisParamsToCtr(int firstAxis, float *ctr)
+{
+	int param, i;
+
+	for (param = 0; param < AXIS_PAR_COUNT; param++)
+	{
+		for (i = 0; i < AXIS_LEGACY_COUNT && firstAxis + i < AxisCount && g_paramCtrBase[param] >= 0; i++)
+		{
+			ctr[g_paramCtrBase[param] + i] = AxisParam[param][firstAxis + i];
+		}
+	}
+}
+
+/**
+ *  @brief  Set a parameter of an axis; for a legacy axis it is published to the host through CTR_FLG.
+ *
+ *  @return value, like HostSetCtr.
+ */
+float AxisSetParam(int ax, int param, float value)
+{
+	int index = AxisCtrIndex(param, ax);
+
+	if (param < 0 || param >= AXIS_PAR_COUNT || ax < 0 || ax >= AxisCount)
+	{
+		return value;
+	}
+
+	if (index >= 0)
+	{
+		HostSetCtr(index, value);
+	}
+	__atomic_store(&AxisParam[param][ax], &value, __ATOMIC_RELAXED);
+	return value;
+}
+
+/**
+ *  @brief  Put the parameters marked resetOnInit back to the defaults of the axis type.
+ */
+void AxisResetParams(int ax, int type)
+{
+	int param;
+
+	for (param = 0; param < AXIS_PAR_COUNT; param++)
+	{
+		if (g_paramReset[param])
+		{
+			AxisSetParam(ax, param, (type == TURRET) ? g_paramTurret[param] : g_paramDefault[param]);
+		}
+	}
+}
+
+/**
+ *  @brief  Store the name and type of an axis above the legacy ones. Reactor thread.
+ *
+ *  @return 0 when the axis is out of range or a legacy axis, which is named with E_AXS_NAM*.
+ */
+int AxisDefine(const AXIS_DEF *def)
+{
+	if (def->axis < AXIS_LEGACY_COUNT || def->axis >= AxisCount)
+	{
+		return 0;
+	}
+
+	pthread_mutex_lock(&g_defLock);
+	memcpy(g_defName[def->axis], def->name, AXIS_NAME_LEN);
+	g_defName[def->axis][AXIS_NAME_LEN - 1] = 0;
+	g_defType[def->axis] = def->type;
+	pthread_mutex_unlock(&g_defLock);
+	return 1;
+}
+
+/**
+ *  @brief  Name and type stored with AxisDefine, "NA" and NA when the axis was never defined.
+ */
+void AxisDefinition(int ax, char *name, int *type)
+{
+	pthread_mutex_lock(&g_defLock);
+	if (g_defName[ax][0])
+	{
+		strcpy(name, g_defName[ax]);
+	}
+	else
+	{
+		strcpy(name, "NA");
+	}
+	*type = g_defType[ax];
+	pthread_mutex_unlock(&g_defLock);
+}
+
+/**
+ *  @brief  Status flags of an axis: Shared_StatFlag of the node owning it, the registry copy when the
+ *          node has no shared memory or no node owns the axis.
+ */
+unsigned int* AxisStatFlag(int ax)
+{
+	SHMEM_DATA *shm = NodeShmOfAxis(ax);
+
+	if (shm)
+	{
+		return &shm->Shared_StatFlag[ax % AXIS_LEGACY_COUNT];
+	}
+	return &g_statFlag[ax];
+}
+
+/**
+ *  @brief  1 when the status flags of the axis are kept by the UDSX of its node, so the in position flag
+ *          0x01 follows the drive; 0 when they are the registry copy.
+ */
+int AxisHasUdsx(int ax)
+{
+	return NodeShmOfAxis(ax) != NULL;
+}
+
+/**
+ *  @brief  Axes with a command waiting in the AxisCmdQueue. Control thread.
+ *
+ *  A host command for an axis takes it back from a path, a tuning sweep or a program driving it.
+ */
+AXIS_MASK AxisCmdQueued(void)
+{
+	AXIS_MASK queued = 0;
+	int i;
+
+	for (i = 0; i < AxisCmdCount; i++)
+	{
+		queued |= AXIS_BIT(AxisCmdQueue[i].axis);
+	}
+	return queued;
+}
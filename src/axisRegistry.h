@@ -0,0 +1,103 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Axis registry: the per-axis state of the server, sized at startup.
+ *
+ *  The number of axes is read once by AxisRegistryInit from the environment (AXIS_COUNT_ENV), between
+ *  1 and AXIS_MAX, AXIS_LEGACY_COUNT per node (node.h) when it is not set. Every per-axis array of
+ *  rushEmb.h (sacAxis, SacConnected, Axis_Type, distance, ...) is then allocated for that count and
+ *  addressed by axis id.
+ *  The state is kept as one array per field, so the loops of the control cycle walk contiguous memory.
+ *
+ *  Only the first AXIS_LEGACY_COUNT axes are carried by the legacy interfaces: CMD_FLG, CTR_FLG and
+ *  E_AXS_NAM0..9/E_AXS_TYPE. The axes above them are defined with E_AXIS_DEF, parametrized with
+ *  E_AXIS_PARAM and driven with E_AXIS_CMD. Each block of AXIS_LEGACY_COUNT axes is the AXIS_SETTING
+ *  and SHMEM_DATA of one node; axes without a node keep their status flags in the registry (AxisStatFlag).
+ *
+ *  Per-axis parameters are listed once in AXIS_PARAM_LIST. The list generates the parameter ids, their
+ *  defaults and the CTR_FLG block each parameter is mirrored to for the legacy axes, CTR_FLG[base + axis].
+ */
+
+#ifndef _RUSH_AXIS_REGISTRY_H_
+#define _RUSH_AXIS_REGISTRY_H_
+
+#include <stdint.h>
+#include <nycedefs.h>
+
+#define AXIS_MAX				64			/* largest axis count, one bit per axis in AXIS_MASK */
+#define AXIS_LEGACY_COUNT		10			/* axes of the shared memory, CTR_FLG and CMD_FLG */
+#define AXIS_NAME_LEN			20
+#define AXIS_COUNT_ENV			"RUSH_AXIS_COUNT"
+
+typedef uint64_t AXIS_MASK;
+
+#define AXIS_BIT(ax)			((AXIS_MASK)1 << (ax))
+
+/*
+ * X(id, ctrBase, resetOnInit, default, turretDefault), ctrBase -1 for a parameter without CTR_FLG block
+ */
+#define AXIS_PARAM_LIST(X) \
+	X(AXIS_PAR_WORK_POS,		 0,	1,	   0,	 0)		/* pusher work position */ \
+	X(AXIS_PAR_DEF_DISTANCE,	20,	1,	1000,	10)		/* profile distance when a command has none */ \
+	X(AXIS_PAR_DEF_DURATION,	30,	1,	   1,	 1)		/* profile duration when a command has none */ \
+	X(AXIS_PAR_ABSOLUTE,		50,	0,	   0,	 0)		/* turret moves, 0 relative, else absolute */ \
+	X(AXIS_PAR_STANDBY_POS,		60,	0,	   0,	 0) \
+	X(AXIS_PAR_PROFILE,			-1,	0,	   0,	 0)		/* PROFILE_KIND of moves without one, see profile.h */ \
+	X(AXIS_PAR_VMAX,			-1,	0,	   0,	 0)		/* PROFILE_TIME_OPTIMAL limits, 0 not set */ \
+	X(AXIS_PAR_AMAX,			-1,	0,	   0,	 0) \
+	X(AXIS_PAR_JMAX,			-1,	0,	   0,	 0)		/* 0 unlimited jerk */ \
+	X(AXIS_PAR_SYNC_GROUP,		-1,	0,	   0,	 0)		/* moves of a group started together finish together, 0 none */ \
+	X(AXIS_PAR_SETTLE_BAND,		-1,	0,	   1,	 1)		/* settled within target +- band, see axisStats.h */
+
+#define AXIS_PARAM_ENUM(id, ctrBase, reset, def, turretDef)		id,
+
+enum AXIS_PARAM{
+	AXIS_PARAM_LIST(AXIS_PARAM_ENUM)
+
+	AXIS_PAR_COUNT
+};
+
+/**
+ * @brief   E_AXIS_DEF payload, names and types an axis. Takes effect on the next init.
+ */
+typedef struct axis_def
+{
+	int					axis;
+	int					type;				/**< TURRET, VC_PUSHER, STD_ABS, STD_REL or NA */
+	char				name[AXIS_NAME_LEN];
+} AXIS_DEF;
+
+/**
+ * @brief   E_AXIS_PARAM payload, sets one parameter of one axis.
+ */
+typedef struct axis_param_cfg
+{
+	int					axis;
+	int					param;				/**< AXIS_PARAM */
+	float				value;
+} AXIS_PARAM_CFG;
+
+extern int AxisCount;
+extern float *AxisParam[AXIS_PAR_COUNT];	/* AxisParam[param][axis] */
+
+NYCE_STATUS AxisRegistryInit(int defaultCount);
+int AxisCtrIndex(int param, int ax);
+void AxisParamsFromCtr(const float *ctr);
+void AxisParamsToCtr(int firstAxis, float *ctr);
+float AxisSetParam(int ax, int param, float value);
+void AxisResetParams(int ax, int type);
+int AxisDefine(const AXIS_DEF *def);
+void AxisDefinition(int ax, char *name, int *type);
+unsigned int* AxisStatFlag(int ax);
+int AxisHasUdsx(int ax);
+AXIS_MASK AxisCmdQueued(void);
+
+#endif
@@ -0,0 +1,366 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Per-axis motion statistics, see axisStats.h.
+ *
+ *  AxisStatsEvent and AxisStatsPoll run on the control thread, which alone writes the statistics; they are
+ *  published per axis under a sequence counter like the control statistics. AxisStatsRead, AxisStatsReset
+ *  and AxisStatsExport run on the reactor.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "rushEmb.h"
+#include "axisStats.h"
+#include "axisRegistry.h"
+#include "node.h"
+#include "monotonic.h"
+
+/* tracked state of an axis */
+#define STATS_IDLE				0
+#define STATS_MOVING			1		/* started, sampling */
+#define STATS_SETTLING			2		/* in position, sampling until the deadline */
+
+/* accumulated quantities, in the order of AXIS_STATS */
+#define STATS_DISTANCE			0
+#define STATS_PLANNED			1
+#define STATS_ACTUAL			2
+#define STATS_LATENCY			3
+#define STATS_OVERSHOOT			4
+#define STATS_SETTLE			5
+#define STATS_QUANTITIES		6
+
+typedef struct stats_track
+{
+	int					state;
+	int					measured;			/**< VC_POS is available for the axis */
+	uint64_t			plannedEnd_ns;		/**< MOVE_STARTED plus the planned duration of its sync group */
+	uint64_t			inBand_ns;			/**< Since when VC_POS is within the band, 0 outside */
+	uint64_t			deadline_ns;
+	double				target;
+	double				direction;
+	float				value[STATS_QUANTITIES];
+} STATS_TRACK;
+
+typedef struct stats_sum
+{
+	double				sum[STATS_QUANTITIES];
+	uint32_t			moves;
+	uint32_t			failures;
+} STATS_SUM;
+
+static STATS_TRACK			g_tracks[AXIS_MAX];		// control thread
+static STATS_SUM			g_sums[AXIS_MAX];
+static AXIS_MASK			g_sampling = 0;
+static AXIS_MASK			g_resetMask = 0;		// set by the reactor, applied by the control thread
+
+static AXIS_STATS			g_published[AXIS_MAX];
+static unsigned int			g_seq[AXIS_MAX];
+
+
+static AXIS_STAT* StatsQuantity(AXIS_STATS *stats, int quantity)
+{
+	return &stats->distance + quantity;
+}
+
+/**
+ *  @brief  Measured position of an axis, VC_POS in the shared memory of its node.
+ *
+ *  @return 0 when the axis has no UDSX.
+ */
+static int StatsPosition(int ax, double *position)
+{
+	SHMEM_DATA *shm = NodeShmOfAxis(ax);
+
+	if (shm == NULL)
+	{
+		return 0;
+	}
+	*position = shm->VC_POS[ax % AXIS_LEGACY_COUNT];
+	return 1;
+}
+
+static void StatsPublish(int ax)
+{
+	int q;
+	AXIS_STATS *stats = &g_published[ax];
+	AXIS_STAT *stat;
+
+	__atomic_store_n(&g_seq[ax], g_seq[ax] + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	stats->axis = ax;
+	stats->moves = g_sums[ax].moves;
+	stats->failures = g_sums[ax].failures;
+	for (q = 0; q < STATS_QUANTITIES; q++)
+	{
+		stat = StatsQuantity(stats, q);
+		if (g_sums[ax].moves == 0)
+		{
+			memset(stat, 0, sizeof(*stat));
+			continue;
+		}
+		stat->last = g_tracks[ax].value[q];
+		stat->avg = g_sums[ax].sum[q] / g_sums[ax].moves;
+		if (g_sums[ax].moves == 1 || stat->last > stat->max)
+		{
+			stat->max = stat->last;
+		}
+	}
+
+	__atomic_store_n(&g_seq[ax], g_seq[ax] + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  @brief  Close the sampling of a move and add it to the statistics of its axis.
+ */
+static void StatsFinish(int ax, uint64_t now)
+{
+	STATS_TRACK *track = &g_tracks[ax];
+	int q;
+
+	if (track->measured)
+	{
+		if (track->inBand_ns == 0)
+		{
+			track->inBand_ns = now;			//never settled within the window
+		}
+		track->value[STATS_SETTLE] = (track->inBand_ns > track->plannedEnd_ns) ? (track->inBand_ns - track->plannedEnd_ns) / 1e9 : 0;
+	}
+
+	for (q = 0; q < STATS_QUANTITIES; q++)
+	{
+		g_sums[ax].sum[q] += track->value[q];
+	}
+	g_sums[ax].moves++;
+
+	track->state = STATS_IDLE;
+	g_sampling &= ~AXIS_BIT(ax);
+	StatsPublish(ax);
+}
+
+/**
+ *  @brief  Follow a move through its events. Called by moveEvent.c for every event it emits.
+ */
+void AxisStatsEvent(const MOVE_EVENT *event)
+{
+	int ax = event->axis;
+	STATS_TRACK *track = &g_tracks[ax];
+	double position;
+
+	switch (event->type)
+	{
+		case MOVE_ACCEPTED:
+			//the new move ends the sampling of the last one, a move replaced before in position is not counted
+			if (track->state == STATS_SETTLING)
+			{
+				StatsFinish(ax, event->timestamp_ns);
+			}
+			track->state = STATS_IDLE;
+			g_sampling &= ~AXIS_BIT(ax);
+			break;
+
+		case MOVE_STARTED:
+			memset(track->value, 0, sizeof(track->value));
+			track->value[STATS_DISTANCE] = (distance[ax] < 0) ? -distance[ax] : distance[ax];
+			track->value[STATS_PLANNED] = event->planned;
+			track->value[STATS_LATENCY] = event->actual;
+			track->plannedEnd_ns = event->timestamp_ns + (uint64_t)(event->planned * 1e9);
+			track->inBand_ns = 0;
+			track->measured = StatsPosition(ax, &position);
+			if (track->measured)
+			{
+				track->target = position + distance[ax];
+			}
+			track->direction = (distance[ax] < 0) ? -1 : 1;
+			track->state = STATS_MOVING;
+			g_sampling |= AXIS_BIT(ax);
+			break;
+
+		case MOVE_FAILED:
+			g_sums[ax].failures++;
+			StatsPublish(ax);
+			break;
+
+		case MOVE_IN_POSITION:
+			if (track->state != STATS_MOVING)
+			{
+				break;
+			}
+			track->value[STATS_ACTUAL] = event->actual;
+			if (!track->measured)
+			{
+				StatsFinish(ax, event->timestamp_ns);
+				break;
+			}
+			track->state = STATS_SETTLING;
+			track->deadline_ns = event->timestamp_ns + AXIS_STATS_SETTLE_MS * 1000000ULL;
+			break;
+	}
+}
+
+/**
+ *  @brief  Apply the resets of the reactor and sample VC_POS of the moving axes. Once per control cycle.
+ */
+void AxisStatsPoll(void)
+{
+	int ax;
+	AXIS_MASK reset;
+	uint64_t now;
+	double position, error;
+	STATS_TRACK *track;
+
+	reset = __atomic_exchange_n(&g_resetMask, 0, __ATOMIC_ACQ_REL);
+	for (ax = 0; ax < AxisCount && reset; ax++)
+	{
+		if (reset & AXIS_BIT(ax))
+		{
+			reset &= ~AXIS_BIT(ax);
+			memset(&g_sums[ax], 0, sizeof(g_sums[ax]));
+			StatsPublish(ax);
+		}
+	}
+
+	if (g_sampling == 0)
+	{
+		return;
+	}
+
+	now = MonotonicNs();
+	for (ax = 0; ax < AxisCount; ax++)
+	{
+		track = &g_tracks[ax];
+		if (!(g_sampling & AXIS_BIT(ax)) || !track->measured || !StatsPosition(ax, &position))
+		{
+			continue;
+		}
+
+		error = position - track->target;
+		if (error * track->direction > track->value[STATS_OVERSHOOT])
+		{
+			track->value[STATS_OVERSHOOT] = error * track->direction;
+		}
+
+		if (error <= AxisParam[AXIS_PAR_SETTLE_BAND][ax] && error >= -AxisParam[AXIS_PAR_SETTLE_BAND][ax])
+		{
+			if (track->inBand_ns == 0)
+			{
+				track->inBand_ns = now;
+			}
+		}
+		else
+		{
+			track->inBand_ns = 0;
+		}
+
+		if (track->state == STATS_SETTLING && now >= track->deadline_ns)
+		{
+			StatsFinish(ax, now);
+		}
+	}
+}
+
+/**
+ *  @brief  Copy the statistics of an axis. Reactor thread.
+ *
+ *  @return 0 when the axis is out of range.
+ */
+int AxisStatsRead(int ax, AXIS_STATS *stats)
+{
+	unsigned int seq;
+
+	if (ax < 0 || ax >= AxisCount)
+	{
+		return 0;
+	}
+
+	do
+	{
+		seq = __atomic_load_n(&g_seq[ax], __ATOMIC_ACQUIRE);
+		*stats = g_published[ax];
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	}
+	while ((seq & 1) || __atomic_load_n(&g_seq[ax], __ATOMIC_RELAXED) != seq);
+
+	stats->axis = ax;
+	stats->commands = SacMovedCnt[ax];
+	return 1;
+}
+
+/**
+ *  @brief  Start the statistics of an axis, -1 for every axis, over in the next control cycle.
+ */
+void AxisStatsReset(int ax)
+{
+	if (ax < 0)
+	{
+		__atomic_store_n(&g_resetMask, ~(AXIS_MASK)0, __ATOMIC_RELEASE);
+	}
+	else if (ax < AxisCount)
+	{
+		__atomic_or_fetch(&g_resetMask, AXIS_BIT(ax), __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ *  @brief  Append the statistics of every axis with moves to a CSV file, with a header when it is new.
+ *
+ *  @return 0 when the file cannot be written.
+ */
+int AxisStatsExport(const char *path)
+{
+	static const char *names[STATS_QUANTITIES] = { "distance", "planned", "actual", "latency", "overshoot", "settle" };
+	FILE *file;
+	AXIS_STATS stats;
+	AXIS_STAT *stat;
+	struct timespec now;
+	int ax, q;
+
+	file = fopen(path, "a");
+	if (file == NULL)
+	{
+		logging(100,0,"cannot open axis statistics export","AxisStatsExport");  ////////////////log
+		return 0;
+	}
+
+	fseek(file, 0, SEEK_END);
+	if (ftell(file) == 0)
+	{
+		fprintf(file, "time,axis,name,commands,moves,failures");
+		for (q = 0; q < STATS_QUANTITIES; q++)
+		{
+			fprintf(file, ",%s_last,%s_avg,%s_max", names[q], names[q], names[q]);
+		}
+		fprintf(file, "\n");
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	for (ax = 0; ax < AxisCount; ax++)
+	{
+		if (!AxisStatsRead(ax, &stats) || (stats.moves == 0 && stats.failures == 0))
+		{
+			continue;
+		}
+
+		fprintf(file, "%ld,%d,%s,%u,%u,%u", (long)now.tv_sec, ax, Axis_Name[ax], stats.commands, stats.moves, stats.failures);
+		for (q = 0; q < STATS_QUANTITIES; q++)
+		{
+			stat = StatsQuantity(&stats, q);
+			fprintf(file, ",%g,%g,%g", stat->last, stat->avg, stat->max);
+		}
+		fprintf(file, "\n");
+	}
+
+	fclose(file);
+	return 1;
+}
@@ -0,0 +1,86 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Per-axis motion statistics, built from the move events (moveEvent.h) and the measured position.
+ *
+ *  For every move the control thread keeps the commanded distance, the planned duration as stretched by the
+ *  sync group of the axis, the latency from planning to the start of the move, and the measured time until
+ *  the axis is in position. Axes with a UDSX also get overshoot and settle time from the VC_POS of the axis
+ *  in the shared memory of its node. They are sampled every control cycle from the start of the move until
+ *  AXIS_STATS_SETTLE_MS after in position, or until the next move starts:
+ *
+ *      overshoot   largest travel past the target, in the direction of the move
+ *      settle      time from the planned end of the move until VC_POS stays within AXIS_PAR_SETTLE_BAND
+ *
+ *  A failed SacPointToPoint only counts in failures, a move replaced by the next one before it is in position
+ *  is not counted.
+ *
+ *  E_AXIS_STATS (payload AXIS_STATS_REQ) answers with an E_AXIS_STATS frame of AXIS_STATS, one per axis
+ *  requested; AXIS_STATS_RESET starts the statistics of those axes over, AXIS_STATS_EXPORT also appends
+ *  them to the CSV file AXIS_STATS_CSV.
+ */
+
+#ifndef _RUSH_AXIS_STATS_H_
+#define _RUSH_AXIS_STATS_H_
+
+#include <stdint.h>
+#include "moveEvent.h"
+
+#define AXIS_STATS_SETTLE_MS	200
+#define AXIS_STATS_CSV			"/home/user/rushAxisStats.csv"
+
+/* AXIS_STATS_REQ flags */
+#define AXIS_STATS_RESET		0x01
+#define AXIS_STATS_EXPORT		0x02
+
+/**
+ * @brief   One quantity over the moves since the last reset.
+ */
+typedef struct axis_stat
+{
+	float				last;
+	float				avg;
+	float				max;
+} AXIS_STAT;
+
+/**
+ * @brief   E_AXIS_STATS reply element. Times in seconds, distances in axis units.
+ */
+typedef struct axis_stats
+{
+	int32_t				axis;
+	uint32_t			commands;			/**< Axis commands executed since start, SacMovedCnt */
+	uint32_t			moves;				/**< Moves in position since the last reset */
+	uint32_t			failures;			/**< Moves SacPointToPoint refused since the last reset */
+	AXIS_STAT			distance;
+	AXIS_STAT			planned;			/**< After the sync group stretch */
+	AXIS_STAT			actual;				/**< Start to in position */
+	AXIS_STAT			latency;			/**< Planned to started */
+	AXIS_STAT			overshoot;			/**< 0 without UDSX */
+	AXIS_STAT			settle;				/**< 0 without UDSX */
+} AXIS_STATS;
+
+/**
+ * @brief   E_AXIS_STATS request.
+ */
+typedef struct axis_stats_req
+{
+	int32_t				axis;				/**< -1 for every axis */
+	int32_t				flags;				/**< AXIS_STATS_RESET, AXIS_STATS_EXPORT */
+} AXIS_STATS_REQ;
+
+void AxisStatsEvent(const MOVE_EVENT *event);
+void AxisStatsPoll(void);
+int AxisStatsRead(int ax, AXIS_STATS *stats);
+void AxisStatsReset(int ax);
+int AxisStatsExport(const char *path);
+
+#endif
@@ -0,0 +1,386 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Real-time control thread, see control.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "rushEmb.h"
+#include "hostState.h"
+#include "control.h"
+#include "ptpBatch.h"
+#include "axisRegistry.h"
+#include "monotonic.h"
+
+#define CONTROL_ERR_FAILED_TO_START		USR_ERROR(113)
+
+static pthread_t			g_controlThread;
+static volatile int			g_controlRun = 0;
+static int					g_controlRealtime = 0;	// 1 when SCHED_FIFO was granted
+
+/* Reactor -> control thread command queue, one producer and one consumer */
+static AXIS_CMD				g_queue[CONTROL_QUEUE_SIZE];
+static unsigned int			g_queueHead = 0;		// written by the reactor
+static unsigned int			g_queueTail = 0;		// written by the control thread
+static unsigned int			g_queueDropped = 0;
+static int					g_clearCommands = 0;
+
+/* Main thread -> control thread pause handshake */
+static int					g_pauseDepth = 0;		// main thread only
+static unsigned int			g_pauseGen = 0;			// main thread only
+static unsigned int			g_pauseRequest = 0;		// generation asked for, 0 when running
+static unsigned int			g_pauseAck = 0;			// last generation the control thread stopped for
+
+static unsigned int			g_hostVersion = 0;
+static HOST_STATE			g_host;
+
+/* Statistics: the control thread fills g_window and publishes it into g_report */
+static CONTROL_STATS		g_window;
+static double				g_jitterSum, g_cycleSum;
+static CONTROL_STATS		g_report;
+static unsigned int			g_reportSeq = 0;
+static unsigned int			g_reportedWindow = 0;
+
+
+static void ControlAddTime(struct timespec *ts, long ns)
+{
+	ts->tv_nsec += ns;
+	while (ts->tv_nsec >= 1000000000L)
+	{
+		ts->tv_nsec -= 1000000000L;
+		ts->tv_sec++;
+	}
+}
+
+/**
+ *  @brief  Queue an axis command for the control thread. Reactor only.
+ *
+ *  @return 1 when queued, 0 when the queue is full.
+ */
+int ControlPush(const AXIS_CMD *cmd)
+{
+	unsigned int head = g_queueHead;
+	unsigned int tail = __atomic_load_n(&g_queueTail, __ATOMIC_ACQUIRE);
+
+	if (head - tail >= CONTROL_QUEUE_SIZE)
+	{
+		__atomic_add_fetch(&g_queueDropped, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	g_queue[head & (CONTROL_QUEUE_SIZE - 1)] = *cmd;
+	__atomic_store_n(&g_queueHead, head + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+static int ControlPop(AXIS_CMD *cmd)
+{
+	unsigned int tail = g_queueTail;
+	unsigned int head = __atomic_load_n(&g_queueHead, __ATOMIC_ACQUIRE);
+
+	if (head == tail)
+	{
+		return 0;
+	}
+
+	*cmd = g_queue[tail & (CONTROL_QUEUE_SIZE - 1)];
+	__atomic_store_n(&g_queueTail, tail + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/**
+ *  @brief  Drop the queued commands at the start of the next control cycle.
+ */
+void ControlClearCommands(void)
+{
+	__atomic_store_n(&g_clearCommands, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  @brief  Hold the control thread between cycles, returns once it runs no cycle anymore. Main thread.
+ *
+ *  Calls nest; the thread runs again after the matching ControlResume.
+ */
+void ControlPause(void)
+{
+	if (g_pauseDepth++ > 0)
+	{
+		return;
+	}
+
+	if (++g_pauseGen == 0)
+	{
+		g_pauseGen = 1;
+	}
+	__atomic_store_n(&g_pauseRequest, g_pauseGen, __ATOMIC_RELEASE);
+
+	//the thread acknowledges at the start of its next cycle, after a SAC call it is blocked in
+	while (g_controlRun && __atomic_load_n(&g_pauseAck, __ATOMIC_ACQUIRE) != g_pauseGen)
+	{
+		usleep(CONTROL_PERIOD_US / 4);
+	}
+}
+
+void ControlResume(void)
+{
+	if (g_pauseDepth > 0 && --g_pauseDepth == 0)
+	{
+		__atomic_store_n(&g_pauseRequest, 0, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ *  @brief  One control cycle: take the new host state and commands, then run the axes.
+ */
+static void ControlCycle(void)
+{
+	AXIS_CMD cmd;
+	unsigned int version;
+
+	if (__atomic_exchange_n(&g_clearCommands, 0, __ATOMIC_ACQ_REL))
+	{
+		while (ControlPop(&cmd))
+		{
+		}
+		AxisCmdCount = 0;
+	}
+
+	version = HostVersion();
+	if (version != g_hostVersion)
+	{
+		HostRead(&g_host);
+		memcpy(CTR_FLG, g_host.CTR_FLG, sizeof(CTR_FLG));
+		memcpy(FORCE_LIMIT, g_host.FORCE_LIMIT, sizeof(FORCE_LIMIT));
+		AxisParamsFromCtr(CTR_FLG);
+		g_hostVersion = version;
+	}
+
+	while (AxisCmdCount < AXIS_CMD_QUEUE && ControlPop(&cmd))
+	{
+		AxisCmdQueue[AxisCmdCount++] = cmd;
+	}
+
+	NyceApplyCommands();
+}
+
+static void ControlPublishWindow(void)
+{
+	PTP_BATCH_STATS batch;
+
+	PtpBatchTakeStats(&batch);
+	g_window.batches = batch.batches;
+	g_window.skewAvg = batch.batches ? batch.skewSum / batch.batches : 0;
+	g_window.skewMax = batch.skewMax;
+
+	g_window.window++;
+	g_window.dropped = __atomic_load_n(&g_queueDropped, __ATOMIC_RELAXED);
+	g_window.jitterAvg = g_jitterSum / g_window.cycles;
+	g_window.cycleAvg = g_cycleSum / g_window.cycles;
+
+	__atomic_store_n(&g_reportSeq, g_reportSeq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	g_report = g_window;
+	__atomic_store_n(&g_reportSeq, g_reportSeq + 1, __ATOMIC_RELEASE);
+
+	/* ControlReport runs on the main thread */
+	HostPostEvent();
+
+	g_window.cycles = g_window.overruns = 0;
+	g_window.jitterMin = g_window.cycleMin = 1e9;
+	g_window.jitterMax = g_window.cycleMax = 0;
+	g_jitterSum = g_cycleSum = 0;
+}
+
+/**
+ *  @brief  Touch the stack the thread will use so no page fault happens inside a cycle.
+ */
+static void ControlPrefaultStack(void)
+{
+	volatile char stack[CONTROL_STACK_PREFAULT];
+
+	memset((char*)stack, 0, sizeof(stack));
+}
+
+static void* ControlThreadFunc(void *arg)
+{
+	struct timespec next, done;
+	uint64_t wake_ns, done_ns;
+	cpu_set_t cpus;
+	double jitter, cycle;
+	unsigned int pause;
+
+	(void)arg;
+
+	ControlPrefaultStack();
+
+	//before pinning, so the workers inherit the priority but not the CPU
+	if (PtpBatchStart() == 0)
+	{
+		logging(100,0,"no move workers, axes start one after the other","ControlThreadFunc");  ////////////////log
+	}
+
+	if (CONTROL_CPU < sysconf(_SC_NPROCESSORS_ONLN))
+	{
+		CPU_ZERO(&cpus);
+		CPU_SET(CONTROL_CPU, &cpus);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	}
+
+	g_window.jitterMin = g_window.cycleMin = 1e9;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	while (g_controlRun)
+	{
+		ControlAddTime(&next, CONTROL_PERIOD_US * 1000L);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		pause = __atomic_load_n(&g_pauseRequest, __ATOMIC_ACQUIRE);
+		if (pause)
+		{
+			__atomic_store_n(&g_pauseAck, pause, __ATOMIC_RELEASE);
+			continue;
+		}
+
+		wake_ns = MonotonicNs();
+
+		ControlCycle();
+
+		clock_gettime(CLOCK_MONOTONIC, &done);
+		done_ns = TimespecNs(&done);
+		jitter = (int64_t)(wake_ns - TimespecNs(&next)) / 1e3;
+		cycle = (done_ns - wake_ns) / 1e3;
+
+		g_window.cycles++;
+		g_jitterSum += jitter;
+		g_cycleSum += cycle;
+		if (jitter < g_window.jitterMin) g_window.jitterMin = jitter;
+		if (jitter > g_window.jitterMax) g_window.jitterMax = jitter;
+		if (cycle < g_window.cycleMin) g_window.cycleMin = cycle;
+		if (cycle > g_window.cycleMax) g_window.cycleMax = cycle;
+
+		if (done_ns - TimespecNs(&next) > CONTROL_PERIOD_US * 1000ULL)
+		{
+			/* a blocking SAC call ate whole periods: restart the schedule instead of bursting to catch up */
+			g_window.overruns++;
+			next = done;
+		}
+
+		if (g_window.cycles == CONTROL_REPORT_CYCLES)
+		{
+			ControlPublishWindow();
+		}
+	}
+
+	PtpBatchStop();
+	return NULL;
+}
+
+/**
+ *  @brief  Lock the process memory and start the control thread.
+ *
+ *  Without the rights for SCHED_FIFO the thread still runs, with normal scheduling.
+ */
+NYCE_STATUS ControlStart(void)
+{
+	pthread_attr_t attr;
+	struct sched_param param;
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+	{
+		logging(100,0,"mlockall failed","ControlStart");  ////////////////log
+	}
+
+	g_controlRun = 1;
+	g_hostVersion = 0;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, CONTROL_STACK_SIZE);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	param.sched_priority = CONTROL_PRIORITY;
+	pthread_attr_setschedparam(&attr, &param);
+
+	g_controlRealtime = (pthread_create(&g_controlThread, &attr, ControlThreadFunc, NULL) == 0);
+	if (!g_controlRealtime)
+	{
+		logging(100,CONTROL_PRIORITY,"SCHED_FIFO refused, control thread not real-time","ControlStart");  ////////////////log
+		pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+		if (pthread_create(&g_controlThread, &attr, ControlThreadFunc, NULL) != 0)
+		{
+			g_controlRun = 0;
+			pthread_attr_destroy(&attr);
+			return CONTROL_ERR_FAILED_TO_START;
+		}
+	}
+
+	pthread_attr_destroy(&attr);
+	return NYCE_OK;
+}
+
+void ControlStop(void)
+{
+	if (g_controlRun)
+	{
+		g_controlRun = 0;
+		pthread_join(g_controlThread, NULL);
+		ControlReport();
+	}
+}
+
+/**
+ *  @brief  Copy the statistics of the last complete window.
+ *
+ *  @return 0 when no window is complete yet.
+ */
+int ControlStats(CONTROL_STATS *stats)
+{
+	unsigned int seq;
+
+	do
+	{
+		seq = __atomic_load_n(&g_reportSeq, __ATOMIC_ACQUIRE);
+		*stats = g_report;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	}
+	while ((seq & 1) || __atomic_load_n(&g_reportSeq, __ATOMIC_RELAXED) != seq);
+
+	return stats->window != 0;
+}
+
+/**
+ *  @brief  Log the statistics once per window. Main thread, keeps file I/O off the control thread.
+ */
+void ControlReport(void)
+{
+	CONTROL_STATS stats;
+	char text[100];
+
+	if (!ControlStats(&stats) || stats.window == g_reportedWindow)
+	{
+		return;
+	}
+	g_reportedWindow = stats.window;
+
+	snprintf(text, sizeof(text), "jitter %.0f/%.0f/%.0f cycle %.0f/%.0f/%.0f skew %.0f/%.0f us, %u overruns, %u dropped",
+			 stats.jitterMin, stats.jitterAvg, stats.jitterMax, stats.cycleMin, stats.cycleAvg, stats.cycleMax,
+			 stats.skewAvg, stats.skewMax, stats.overruns, stats.dropped);
+	printf("control%s: %s\n", g_controlRealtime ? "" : " (not real-time)", text);
+	logging(100,(float)stats.jitterMax,"control stats",text);  ////////////////log
+}
@@ -0,0 +1,72 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Real-time control thread running NyceApplyCommands at a fixed period.
+ *
+ *  The blocking SAC calls of NyceMainLoop used to run inside the dyad onData callback, so motion
+ *  latency followed socket activity. They now run on a SCHED_FIFO thread pinned to CONTROL_CPU, with
+ *  the process memory locked and the thread stack prefaulted. The thread wakes on an absolute
+ *  CLOCK_MONOTONIC schedule every CONTROL_PERIOD_US.
+ *
+ *  Axis commands reach the thread through a single-producer/single-consumer queue filled by the
+ *  reactor at the end of its cycle; CTR_FLG and FORCE_LIMIT are read from the published host state
+ *  (hostState.h). Moves of several axes planned in one cycle are started together (ptpBatch.h).
+ *  The thread measures its wake-up jitter, cycle time and the start skew of those moves; the main thread
+ *  logs them.
+ *
+ *  While the main thread rebuilds the axes (AxisInit) it holds the thread between cycles with ControlPause;
+ *  the thread keeps its schedule but runs no cycle until ControlResume.
+ */
+
+#ifndef _RUSH_CONTROL_H_
+#define _RUSH_CONTROL_H_
+
+#include <nycedefs.h>
+#include "rushEmb.h"
+
+#define CONTROL_PERIOD_US		1000
+#define CONTROL_PRIORITY		80			/* SCHED_FIFO, above the NYCe/dyad threads */
+#define CONTROL_CPU				1			/* ignored on a single core */
+#define CONTROL_STACK_SIZE		(256 * 1024)
+#define CONTROL_STACK_PREFAULT	(64 * 1024)
+#define CONTROL_QUEUE_SIZE		64			/* commands, must be a power of two */
+#define CONTROL_REPORT_CYCLES	10000		/* cycles per statistics window */
+
+/**
+ * @brief   Timing of one statistics window, in microseconds.
+ */
+typedef struct control_stats
+{
+	unsigned int		window;				/**< Window number, 0 before the first report */
+	unsigned int		cycles;
+	unsigned int		overruns;			/**< Cycles that took longer than the period */
+	unsigned int		dropped;			/**< Commands refused because the queue was full, since start */
+	double				jitterMin;			/**< Wake-up time minus scheduled time */
+	double				jitterMax;
+	double				jitterAvg;
+	double				cycleMin;			/**< Time spent in one cycle */
+	double				cycleMax;
+	double				cycleAvg;
+	unsigned int		batches;			/**< Moves of several axes started together, see ptpBatch.h */
+	double				skewAvg;			/**< Start skew between the axes of a batch */
+	double				skewMax;
+} CONTROL_STATS;
+
+NYCE_STATUS ControlStart(void);
+void ControlStop(void);
+int ControlPush(const AXIS_CMD *cmd);
+void ControlClearCommands(void);
+void ControlPause(void);
+void ControlResume(void);
+int ControlStats(CONTROL_STATS *stats);
+void ControlReport(void);
+
+#endif
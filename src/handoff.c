@@ -0,0 +1,79 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Upload slots, see handoff.h.
+ */
+
+#include <pthread.h>
+
+#include "handoff.h"
+
+/**
+ *  @brief  Take the slots over before filling one. Reactor thread.
+ */
+void HandoffLock(HANDOFF *handoff)
+{
+	pthread_mutex_lock(&handoff->lock);
+}
+
+/**
+ *  @brief  Hand a filled slot to the control thread and give the slots back.
+ */
+void HandoffPost(HANDOFF *handoff, int slot)
+{
+	__atomic_or_fetch(&handoff->posted, AXIS_BIT(slot), __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&handoff->lock);
+}
+
+/**
+ *  @brief  The slots posted since the last take. Control thread, never blocks.
+ *
+ *  @return 0 when nothing was posted or the reactor is filling a slot; otherwise the posted slots, which
+ *          stay locked until HandoffRelease.
+ */
+AXIS_MASK HandoffTake(HANDOFF *handoff)
+{
+	AXIS_MASK posted;
+
+	if (__atomic_load_n(&handoff->posted, __ATOMIC_ACQUIRE) == 0 || pthread_mutex_trylock(&handoff->lock) != 0)
+	{
+		return 0;
+	}
+
+	posted = handoff->posted;
+	handoff->posted = 0;
+	if (posted == 0)
+	{
+		pthread_mutex_unlock(&handoff->lock);
+	}
+	return posted;
+}
+
+void HandoffRelease(HANDOFF *handoff)
+{
+	pthread_mutex_unlock(&handoff->lock);
+}
+
+/**
+ *  @brief  Ask the control thread to drop everything it runs for the module.
+ */
+void HandoffClear(HANDOFF *handoff)
+{
+	__atomic_store_n(&handoff->clear, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  @brief  Whether HandoffClear was called since the last check. Control thread.
+ */
+int HandoffCleared(HANDOFF *handoff)
+{
+	return __atomic_exchange_n(&handoff->clear, 0, __ATOMIC_ACQ_REL);
+}
@@ -0,0 +1,48 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Upload slots handed from the reactor to the control thread.
+ *
+ *  Paths, armed moves, sequence programs and auto-tune requests are decoded on the reactor and run on the
+ *  control thread. Each module keeps its own slots, one per axis or a single one (slot 0), and a HANDOFF
+ *  that guards them:
+ *
+ *      reactor         HandoffLock, fill the slot, HandoffPost(slot)
+ *      control thread  slots = HandoffTake; copy the slots set in it; HandoffRelease when slots != 0
+ *
+ *  HandoffTake never blocks. While the reactor fills a slot it returns 0 and the slots are taken over in a
+ *  later cycle, so a large upload cannot stall the control cycle. HandoffClear, on a system stop, is
+ *  picked up with HandoffCleared at the start of the next control cycle.
+ */
+
+#ifndef _RUSH_HANDOFF_H_
+#define _RUSH_HANDOFF_H_
+
+#include <pthread.h>
+#include "axisRegistry.h"
+
+typedef struct handoff
+{
+	pthread_mutex_t		lock;			/**< Held by the reactor while it fills a slot */
+	AXIS_MASK			posted;			/**< Slots filled since the last HandoffTake */
+	int					clear;
+} HANDOFF;
+
+#define HANDOFF_INITIALIZER		{ PTHREAD_MUTEX_INITIALIZER, 0, 0 }
+
+void HandoffLock(HANDOFF *handoff);
+void HandoffPost(HANDOFF *handoff, int slot);
+AXIS_MASK HandoffTake(HANDOFF *handoff);
+void HandoffRelease(HANDOFF *handoff);
+void HandoffClear(HANDOFF *handoff);
+int HandoffCleared(HANDOFF *handoff);
+
+#endif
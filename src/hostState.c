@@ -0,0 +1,236 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Versioned double buffer of the host command state, see hostState.h.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "rushEmb.h"
+#include "hostState.h"
+
+float						HostCtrFlg[80];
+float						HostForceLimit[10];
+
+static pthread_mutex_t		g_writeLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Published copies. buffer[version & 1] is the current one, the writer fills the other one and then
+ * advances version. A reader retries when version moved while it was copying.
+ */
+static HOST_STATE			g_buffer[2];
+static unsigned int			g_version = 0;
+
+/* Writes posted outside the update thread, folded into HostCtrFlg by HostSync */
+static float				g_ctrPending[80];
+static unsigned char		g_ctrPendingSet[80];
+static int					g_pendingCount = 0;
+static int					g_clearCommands = 0;
+
+/* Wakes the main thread, -1 when it polls */
+static int					g_eventFd = -1;
+
+/* E_REQ_STAT requests decoded on the update thread, published with the next HostSync */
+static char					g_sysRequest = 0;
+static unsigned int			g_sysRequestCount = 0;
+
+
+/**
+ *  @brief  Publish a new state. Called with g_writeLock held.
+ */
+static void HostPublish(const HOST_STATE *state)
+{
+	unsigned int next = g_version + 1;
+
+	g_buffer[next & 1] = *state;
+	__atomic_store_n(&g_version, next, __ATOMIC_RELEASE);
+}
+
+/**
+ *  @brief  Fold the posted writes into the decoded state and publish it. Update thread only.
+ */
+void HostSync(void)
+{
+	HOST_STATE state;
+	int i, wake;
+
+	pthread_mutex_lock(&g_writeLock);
+
+	if (g_pendingCount)
+	{
+		for (i = 0; i < 80; i++)
+		{
+			if (g_ctrPendingSet[i])
+			{
+				HostCtrFlg[i] = g_ctrPending[i];
+				g_ctrPendingSet[i] = 0;
+			}
+		}
+		g_pendingCount = 0;
+	}
+
+	if (g_clearCommands)
+	{
+		memset(CMD_FLG, 0, sizeof(CMD_FLG));
+		g_clearCommands = 0;
+	}
+
+	memcpy(state.CTR_FLG, HostCtrFlg, sizeof(state.CTR_FLG));
+	memcpy(state.FORCE_LIMIT, HostForceLimit, sizeof(state.FORCE_LIMIT));
+	memcpy(state.AXS_TYPE, AXS_TYPE, sizeof(state.AXS_TYPE));
+	memcpy(state.AXS_NAM[0], AXS_NAM0, sizeof(state.AXS_NAM[0]));
+	memcpy(state.AXS_NAM[1], AXS_NAM1, sizeof(state.AXS_NAM[1]));
+	memcpy(state.AXS_NAM[2], AXS_NAM2, sizeof(state.AXS_NAM[2]));
+	memcpy(state.AXS_NAM[3], AXS_NAM3, sizeof(state.AXS_NAM[3]));
+	memcpy(state.AXS_NAM[4], AXS_NAM4, sizeof(state.AXS_NAM[4]));
+	memcpy(state.AXS_NAM[5], AXS_NAM5, sizeof(state.AXS_NAM[5]));
+	memcpy(state.AXS_NAM[6], AXS_NAM6, sizeof(state.AXS_NAM[6]));
+	memcpy(state.AXS_NAM[7], AXS_NAM7, sizeof(state.AXS_NAM[7]));
+	memcpy(state.AXS_NAM[8], AXS_NAM8, sizeof(state.AXS_NAM[8]));
+	memcpy(state.AXS_NAM[9], AXS_NAM9, sizeof(state.AXS_NAM[9]));
+	state.sysRequest = g_sysRequest;
+	state.sysRequestCount = g_sysRequestCount;
+
+	/* only what the sys_case state machine reacts to wakes the main thread */
+	wake = state.sysRequestCount != g_buffer[g_version & 1].sysRequestCount ||
+		   state.CTR_FLG[19] != g_buffer[g_version & 1].CTR_FLG[19];
+
+	HostPublish(&state);
+
+	pthread_mutex_unlock(&g_writeLock);
+
+	if (wake)
+	{
+		HostPostEvent();
+	}
+}
+
+/**
+ *  @brief  Version of the published state, changes with every publish.
+ */
+unsigned int HostVersion(void)
+{
+	return __atomic_load_n(&g_version, __ATOMIC_ACQUIRE);
+}
+
+/**
+ *  @brief  Copy the last published state. Wait-free for the caller unless a publish overlaps the copy.
+ */
+void HostRead(HOST_STATE *state)
+{
+	unsigned int version;
+
+	do
+	{
+		version = __atomic_load_n(&g_version, __ATOMIC_ACQUIRE);
+		*state = g_buffer[version & 1];
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	}
+	while (__atomic_load_n(&g_version, __ATOMIC_RELAXED) != version);
+}
+
+/**
+ *  @brief  Write one CTR_FLG value from outside the update thread.
+ *
+ *  @return value, so it can be chained like the former CTR_FLG[index] = value.
+ */
+float HostSetCtr(int index, float value)
+{
+	HOST_STATE state;
+
+	if (index < 0 || index >= 80)
+	{
+		return value;
+	}
+
+	pthread_mutex_lock(&g_writeLock);
+
+	g_ctrPending[index] = value;
+	g_ctrPendingSet[index] = 1;
+	g_pendingCount++;
+
+	/* readers see the value before the update thread picks it up */
+	state = g_buffer[g_version & 1];
+	state.CTR_FLG[index] = value;
+	HostPublish(&state);
+
+	pthread_mutex_unlock(&g_writeLock);
+	return value;
+}
+
+/**
+ *  @brief  Drop the CMD_FLG commands not handed to the control thread yet, from the main thread.
+ */
+void HostClearCommands(void)
+{
+	pthread_mutex_lock(&g_writeLock);
+	g_clearCommands = 1;
+	pthread_mutex_unlock(&g_writeLock);
+}
+
+/**
+ *  @brief  Record an E_REQ_STAT request for the main thread. Update thread only.
+ */
+void HostRequestSysCase(char request)
+{
+	g_sysRequest = request;
+	g_sysRequestCount++;
+}
+
+/**
+ *  @brief  Create the eventfd behind HostWaitEvent. Must run before the threads and the signal handler.
+ *
+ *  @return 0, or -1 when HostWaitEvent has to fall back to polling.
+ */
+int HostEventInit(void)
+{
+	g_eventFd = eventfd(0, 0);
+	return (g_eventFd == -1) ? -1 : 0;
+}
+
+/**
+ *  @brief  Wake the main thread. Async-signal-safe.
+ */
+void HostPostEvent(void)
+{
+	uint64_t one = 1;
+
+	if (g_eventFd != -1)
+	{
+		if (write(g_eventFd, &one, sizeof(one)) != sizeof(one))
+		{
+			/* the counter is saturated, the main thread is woken anyway */
+		}
+	}
+}
+
+/**
+ *  @brief  Sleep until HostPostEvent was called since the previous wait; events in between are merged.
+ */
+void HostWaitEvent(void)
+{
+	uint64_t count;
+
+	if (g_eventFd == -1)
+	{
+		usleep(1000);
+		return;
+	}
+
+	if (read(g_eventFd, &count, sizeof(count)) != sizeof(count))
+	{
+		/* interrupted by a signal, the caller looks at g_stop */
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Host command state handed from the dyad update thread to the main thread.
+ *
+ *  The dyad update thread decodes host frames into HostCtrFlg, HostForceLimit, CMD_FLG and the AXS_*
+ *  arrays. Once per reactor cycle HostSync publishes them into a versioned double buffer. The control
+ *  thread (control.h) and the main thread (sys_case state machine, AxisInit) only read the published
+ *  copy with HostRead, which never takes a lock and never sees a half written CTR_FLG set.
+ *
+ *  The few values written outside the update thread (CTR_FLG defaults, the terminate flag CTR_FLG[19],
+ *  the work position of a pusher) are posted with HostSetCtr. They are visible to HostRead at once and
+ *  are folded into HostCtrFlg at the next HostSync. Writers are serialized by a mutex, readers never
+ *  touch it.
+ *
+ *  The main thread sleeps in HostWaitEvent until something it reacts to changes: a new E_REQ_STAT
+ *  request or terminate flag is published, a control statistics window is complete, or a signal
+ *  arrives. HostPostEvent writes an eventfd, so it may be called from a signal handler.
+ */
+
+#ifndef _RUSH_HOST_STATE_H_
+#define _RUSH_HOST_STATE_H_
+
+/**
+ * @brief   Consistent copy of the host written state.
+ */
+typedef struct host_state
+{
+	float				CTR_FLG[80];
+	float				FORCE_LIMIT[10];
+	int					AXS_TYPE[10];
+	char				AXS_NAM[10][20];
+	char				sysRequest;			/**< Last SYS_* requested with E_REQ_STAT */
+	unsigned int		sysRequestCount;	/**< Incremented for every E_REQ_STAT, 0 before the first */
+} HOST_STATE;
+
+/* Decoded by the update thread, published by HostSync */
+extern float HostCtrFlg[80];
+extern float HostForceLimit[10];
+
+void HostSync(void);
+unsigned int HostVersion(void);
+void HostRead(HOST_STATE *state);
+float HostSetCtr(int index, float value);
+void HostClearCommands(void);
+void HostRequestSysCase(char request);
+int HostEventInit(void);
+void HostPostEvent(void);
+void HostWaitEvent(void);
+
+#endif
@@ -0,0 +1,373 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Modbus/TCP front end, see modbus.h. Runs on the dyad update thread.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "rushEmb.h"
+#include "modbus.h"
+#include "hostState.h"
+
+#define MB_MBAP_SIZE			7
+#define MB_MAX_ADU				260
+#define MB_MAX_READ				125
+#define MB_MAX_WRITE			123
+
+/* Function codes */
+#define MB_READ_HOLDING			0x03
+#define MB_READ_INPUT			0x04
+#define MB_WRITE_MULTIPLE		0x10
+
+/* Exception codes */
+#define MB_EX_ILLEGAL_FUNCTION	0x01
+#define MB_EX_ILLEGAL_ADDRESS	0x02
+#define MB_EX_ILLEGAL_VALUE		0x03
+#define MB_EX_DEVICE_FAILURE	0x04
+
+/* Register tables */
+#define MB_HOLDING				0
+#define MB_INPUT				1
+
+/* Element types */
+#define MB_FLOAT32				0
+#define MB_UINT32				1
+#define MB_UINT16				2
+
+/**
+ * @brief   Block of consecutive registers backed by one array.
+ */
+typedef struct mb_mapping
+{
+	int					table;			/**< MB_HOLDING or MB_INPUT */
+	int					address;		/**< First register */
+	int					count;			/**< Number of elements */
+	int					type;			/**< MB_FLOAT32, MB_UINT32 or MB_UINT16 */
+	void*				data;			/**< Backing array, NULL when it lives in pShmem_data */
+	int					shmOffset;		/**< Offset inside SHMEM_DATA when data is NULL */
+} MB_MAPPING;
+
+static const MB_MAPPING g_mbMap[] =
+{
+	{ MB_HOLDING,	  0,	10,	MB_FLOAT32,	CMD_FLG,		0 },
+	{ MB_HOLDING,	100,	80,	MB_FLOAT32,	HostCtrFlg,		0 },
+	{ MB_HOLDING,	300,	10,	MB_FLOAT32,	HostForceLimit,	0 },
+
+	{ MB_INPUT,		  0,	10,	MB_UINT32,	NULL,			offsetof(SHMEM_DATA, STAT_FLG) },
+	{ MB_INPUT,		100,	20,	MB_FLOAT32,	NULL,			offsetof(SHMEM_DATA, VC_POS) },
+	{ MB_INPUT,		200,	10,	MB_FLOAT32,	NULL,			offsetof(SHMEM_DATA, NET_CURRENT) },
+	{ MB_INPUT,		300,	 1,	MB_UINT16,	&sys_case,		0 },
+};
+
+#define MB_MAP_COUNT	(int)(sizeof(g_mbMap) / sizeof(g_mbMap[0]))
+
+typedef struct mb_conn
+{
+	int					active;
+	int					size;
+	unsigned char		buffer[MB_MAX_ADU * 2];
+} MB_CONN;
+
+static MB_CONN g_mbConns[MODBUS_MAX_CONNS];
+
+
+static int MbRegsPerElement(int type)
+{
+	return (type == MB_UINT16) ? 1 : 2;
+}
+
+/**
+ *  @brief  Find the element behind a register.
+ *
+ *  @param[out] word    0 for the high word of a 32-bit element, 1 for the low word.
+ *  @return     Address of the element, NULL when the register is not mapped or not available yet.
+ */
+static void* MbLocate(int table, int address, const MB_MAPPING **mapping, int *word)
+{
+	int i, offset, regs;
+	const MB_MAPPING *m;
+	char *base;
+
+	for (i = 0; i < MB_MAP_COUNT; i++)
+	{
+		m = &g_mbMap[i];
+		regs = MbRegsPerElement(m->type);
+		if (m->table != table || address < m->address || address >= m->address + m->count * regs)
+		{
+			continue;
+		}
+
+		if (m->data)
+		{
+			base = m->data;
+		}
+		else if (pShmem_data)
+		{
+			base = (char*)pShmem_data + m->shmOffset;
+		}
+		else
+		{
+			return NULL;
+		}
+
+		offset = address - m->address;
+		*mapping = m;
+		*word = offset % regs;
+		return base + (offset / regs) * (m->type == MB_UINT16 ? 1 : 4);
+	}
+
+	return NULL;
+}
+
+static int MbReadRegister(int table, int address, unsigned short *value)
+{
+	const MB_MAPPING *m;
+	int word;
+	uint32_t raw;
+	void *element = MbLocate(table, address, &m, &word);
+
+	if (element == NULL)
+	{
+		return 0;
+	}
+
+	if (m->type == MB_UINT16)
+	{
+		*value = *(unsigned char*)element;		/* sys_case is a char */
+	}
+	else
+	{
+		memcpy(&raw, element, sizeof(raw));
+		*value = word ? (raw & 0xFFFF) : (raw >> 16);
+	}
+	return 1;
+}
+
+static int MbWriteRegister(int address, unsigned short value)
+{
+	const MB_MAPPING *m;
+	int word;
+	uint32_t raw;
+	void *element = MbLocate(MB_HOLDING, address, &m, &word);
+
+	if (element == NULL)
+	{
+		return 0;
+	}
+
+	memcpy(&raw, element, sizeof(raw));
+	raw = word ? ((raw & 0xFFFF0000) | value) : ((raw & 0x0000FFFF) | ((uint32_t)value << 16));
+	memcpy(element, &raw, sizeof(raw));
+	return 1;
+}
+
+static unsigned short MbGet16(const unsigned char *p)
+{
+	return (unsigned short)((p[0] << 8) | p[1]);
+}
+
+static void MbPut16(unsigned char *p, unsigned short value)
+{
+	p[0] = value >> 8;
+	p[1] = value & 0xFF;
+}
+
+/**
+ *  @brief  Execute one request PDU.
+ *
+ *  @return Length of the response PDU in out.
+ */
+static int MbProcess(const unsigned char *pdu, int length, unsigned char *out)
+{
+	int function = pdu[0];
+	int address, quantity, i, word, exception = 0;
+	unsigned short value;
+	const MB_MAPPING *m;
+
+	out[0] = function;
+
+	switch (function)
+	{
+		case MB_READ_HOLDING:
+		case MB_READ_INPUT:
+			if (length != 5)
+			{
+				exception = MB_EX_ILLEGAL_VALUE;
+				break;
+			}
+			address = MbGet16(pdu + 1);
+			quantity = MbGet16(pdu + 3);
+			if (quantity < 1 || quantity > MB_MAX_READ)
+			{
+				exception = MB_EX_ILLEGAL_VALUE;
+				break;
+			}
+			for (i = 0; i < quantity; i++)
+			{
+				if (!MbReadRegister(function == MB_READ_HOLDING ? MB_HOLDING : MB_INPUT, address + i, &value))
+				{
+					exception = pShmem_data ? MB_EX_ILLEGAL_ADDRESS : MB_EX_DEVICE_FAILURE;
+					break;
+				}
+				MbPut16(out + 2 + i * 2, value);
+			}
+			if (exception == 0)
+			{
+				out[1] = quantity * 2;
+				return 2 + quantity * 2;
+			}
+			break;
+
+		case MB_WRITE_MULTIPLE:
+			if (length < 6)
+			{
+				exception = MB_EX_ILLEGAL_VALUE;
+				break;
+			}
+			address = MbGet16(pdu + 1);
+			quantity = MbGet16(pdu + 3);
+			if (quantity < 1 || quantity > MB_MAX_WRITE || pdu[5] != quantity * 2 || length != 6 + quantity * 2)
+			{
+				exception = MB_EX_ILLEGAL_VALUE;
+				break;
+			}
+			/* check the whole range first so a bad request changes nothing, and every 32-bit element
+			   in it is written whole, high word first */
+			for (i = 0; i < quantity; i++)
+			{
+				if (MbLocate(MB_HOLDING, address + i, &m, &word) == NULL
+					|| (i == 0 && word != 0)
+					|| (i == quantity - 1 && m->type != MB_UINT16 && word != 1))
+				{
+					exception = MB_EX_ILLEGAL_ADDRESS;
+					break;
+				}
+			}
+			if (exception)
+			{
+				break;
+			}
+			for (i = 0; i < quantity; i++)
+			{
+				MbWriteRegister(address + i, MbGet16(pdu + 6 + i * 2));
+			}
+			NyceStageCommands();
+			memcpy(out, pdu, 5);
+			return 5;
+
+		default:
+			exception = MB_EX_ILLEGAL_FUNCTION;
+			break;
+	}
+
+	out[0] = function | 0x80;
+	out[1] = exception;
+	return 2;
+}
+
+static void onModbusData(dyad_Event *e)
+{
+	MB_CONN *conn = e->udata;
+	unsigned char response[MB_MAX_ADU];
+	int frameLength, pduLength;
+
+	if (conn->size + e->size > (int)sizeof(conn->buffer))
+	{
+		logging(100,(float)e->size,"modbus frame overflow","onModbusData");  ////////////////log
+		dyad_close(e->stream);
+		return;
+	}
+	memcpy(conn->buffer + conn->size, e->data, e->size);
+	conn->size += e->size;
+
+	while (conn->size >= MB_MBAP_SIZE)
+	{
+		/* MBAP: transaction id, protocol id, length (unit id + PDU), unit id */
+		pduLength = MbGet16(conn->buffer + 4) - 1;
+		if (MbGet16(conn->buffer + 2) != 0 || pduLength < 1 || pduLength > MB_MAX_ADU - MB_MBAP_SIZE)
+		{
+			dyad_close(e->stream);
+			return;
+		}
+
+		frameLength = MB_MBAP_SIZE + pduLength;
+		if (conn->size < frameLength)
+		{
+			break;
+		}
+
+		memcpy(response, conn->buffer, MB_MBAP_SIZE);
+		pduLength = MbProcess(conn->buffer + MB_MBAP_SIZE, pduLength, response + MB_MBAP_SIZE);
+		MbPut16(response + 4, pduLength + 1);
+		dyad_write(e->stream, response, MB_MBAP_SIZE + pduLength);
+
+		conn->size -= frameLength;
+		memmove(conn->buffer, conn->buffer + frameLength, conn->size);
+	}
+}
+
+static void onModbusClose(dyad_Event *e)
+{
+	MB_CONN *conn = e->udata;
+
+	conn->active = 0;
+}
+
+static void onModbusAccept(dyad_Event *e)
+{
+	int i;
+	MB_CONN *conn = NULL;
+
+	for (i = 0; i < MODBUS_MAX_CONNS; i++)
+	{
+		if (!g_mbConns[i].active)
+		{
+			conn = &g_mbConns[i];
+			break;
+		}
+	}
+
+	if (conn == NULL)
+	{
+		logging(100,MODBUS_MAX_CONNS,"Too many modbus clients","onModbusAccept");  ////////////////log
+		dyad_close(e->remote);
+		return;
+	}
+
+	conn->active = 1;
+	conn->size = 0;
+	dyad_setNoDelay(e->remote, 1);
+	dyad_addListener(e->remote, DYAD_EVENT_DATA, onModbusData, conn);
+	dyad_addListener(e->remote, DYAD_EVENT_CLOSE, onModbusClose, conn);
+}
+
+static void onModbusError(dyad_Event *e)
+{
+	printf("modbus server error: %s\n", e->msg);
+}
+
+/**
+ *  @brief  Start the Modbus/TCP listener on the dyad reactor.
+ */
+int ModbusListen(int port)
+{
+	dyad_Stream *s;
+
+	memset(g_mbConns, 0, sizeof(g_mbConns));
+
+	s = dyad_newStream();
+	dyad_addListener(s, DYAD_EVENT_ERROR, onModbusError, NULL);
+	dyad_addListener(s, DYAD_EVENT_ACCEPT, onModbusAccept, NULL);
+	return dyad_listen(s, port);
+}
@@ -0,0 +1,42 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Modbus/TCP server served from the dyad reactor, replacing the separate rushModbusEmb process.
+ *
+ *  The register map is a declarative table in modbus.c backed directly by CMD_FLG, the decoded
+ *  CTR_FLG/FORCE_LIMIT (hostState.h) and the pShmem_data feedback arrays. 32-bit values take two
+ *  registers, high word first, and are only written whole: with function 16, starting on the high word.
+ *  Every holding register is half of a float, so function 6 is not supported.
+ *
+ *  Holding registers (function 3, 16)
+ *      0 ..  19    CMD_FLG[10]         float
+ *    100 .. 259    CTR_FLG[80]         float
+ *    300 .. 319    FORCE_LIMIT[10]     float
+ *
+ *  Input registers (function 4)
+ *      0 ..  19    STAT_FLG[10]        uint32
+ *    100 .. 139    VC_POS[20]          float
+ *    200 .. 219    NET_CURRENT[10]     float
+ *    300           sys_case            uint16
+ *
+ *  A write is handled like a host frame on port 6666: the axis commands are handed to the control thread
+ *  at the end of the reactor cycle.
+ */
+
+#ifndef _RUSH_MODBUS_H_
+#define _RUSH_MODBUS_H_
+
+#define MODBUS_PORT				502
+#define MODBUS_MAX_CONNS		8
+
+int ModbusListen(int port);
+
+#endif
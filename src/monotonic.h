@@ -0,0 +1,45 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  CLOCK_MONOTONIC in nanoseconds, the one time base of the server.
+ *
+ *  The control schedule, the move events and their timestamps, the armed moves, the paths and the sequence
+ *  programs all take their time from MonotonicNs, so their times can be compared with each other.
+ */
+
+#ifndef _RUSH_MONOTONIC_H_
+#define _RUSH_MONOTONIC_H_
+
+#include <stdint.h>
+#include <time.h>
+
+static inline uint64_t TimespecNs(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static inline uint64_t MonotonicNs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return TimespecNs(&now);
+}
+
+/**
+ *  @brief  Nanoseconds elapsed since a MonotonicNs time.
+ */
+static inline uint64_t MonotonicSince(uint64_t start_ns)
+{
+	return MonotonicNs() - start_ns;
+}
+
+#endif
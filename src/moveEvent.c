@@ -0,0 +1,210 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Move lifecycle events, see moveEvent.h.
+ *
+ *  MoveEventAccepted, MoveEventIssued and MoveEventPoll run on the control thread, MoveEventDrain on the
+ *  dyad update thread.
+ */
+
+#include <string.h>
+
+#include "rushEmb.h"
+#include "moveEvent.h"
+#include "telemetry.h"
+#include "axisRegistry.h"
+#include "axisStats.h"
+#include "monotonic.h"
+
+/* tracked state of a move */
+#define MOVE_IDLE				0
+#define MOVE_PLANNED			1
+#define MOVE_MOVING				2
+
+typedef struct move_track
+{
+	int					state;
+	uint32_t			move;
+	uint64_t			accepted_ns;
+	uint64_t			started_ns;
+	double				position;
+	float				planned;
+} MOVE_TRACK;
+
+typedef struct move_event_bulk
+{
+	MOVE_EVENT_HEADER	header;
+	MOVE_EVENT			events[MOVE_EVENT_BULK];
+} MOVE_EVENT_BULK_FRAME;
+
+static MOVE_TRACK			g_tracks[AXIS_MAX];		// control thread
+static AXIS_MASK			g_planned = 0;
+static AXIS_MASK			g_moving = 0;
+
+static MOVE_EVENT			g_ring[MOVE_EVENT_RING];
+static unsigned int			g_ringHead = 0;			// written by the control thread
+static unsigned int			g_ringTail = 0;			// written by the reactor
+static unsigned int			g_dropped = 0;
+
+static MOVE_EVENT_BULK_FRAME	g_bulk;				// reactor
+static char					g_bulkFrame[sizeof(MOVE_EVENT_BULK_FRAME) + 8];
+
+
+static void MoveEmit(int ax, int type, int status, uint64_t timestamp, uint64_t since)
+{
+	unsigned int head = g_ringHead;
+	unsigned int tail = __atomic_load_n(&g_ringTail, __ATOMIC_ACQUIRE);
+	MOVE_EVENT event;
+
+	event.timestamp_ns = timestamp;
+	event.move = g_tracks[ax].move;
+	event.axis = ax;
+	event.type = type;
+	event.status = status;
+	event.position = g_tracks[ax].position;
+	event.planned = g_tracks[ax].planned;
+	event.actual = since ? (timestamp - since) / 1e9 : 0;
+
+	AxisStatsEvent(&event);
+
+	if (head - tail >= MOVE_EVENT_RING)
+	{
+		__atomic_add_fetch(&g_dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	g_ring[head & (MOVE_EVENT_RING - 1)] = event;
+	__atomic_store_n(&g_ringHead, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  @brief  A move of ax is planned in m_sacPtpPars[ax], before SacPointToPoint. It is reported by
+ *          MoveEventIssued, once a sync group may have stretched duration[ax].
+ */
+void MoveEventAccepted(int ax)
+{
+	MOVE_TRACK *track = &g_tracks[ax];
+
+	track->state = MOVE_PLANNED;
+	track->move++;
+	track->accepted_ns = MonotonicNs();
+	track->position = m_sacPtpPars[ax].position;
+	g_planned |= AXIS_BIT(ax);
+	g_moving &= ~AXIS_BIT(ax);
+}
+
+/**
+ *  @brief  Report the moves planned in this cycle and the result of their SacPointToPoint. After
+ *          ProfileSyncBatch and PtpBatchIssue.
+ */
+void MoveEventIssued(void)
+{
+	int ax;
+	MOVE_TRACK *track;
+
+	for (ax = 0; ax < AxisCount && g_planned; ax++)
+	{
+		if (!(g_planned & AXIS_BIT(ax)))
+		{
+			continue;
+		}
+		g_planned &= ~AXIS_BIT(ax);
+
+		track = &g_tracks[ax];
+		track->planned = duration[ax];
+		MoveEmit(ax, MOVE_ACCEPTED, NYCE_OK, track->accepted_ns, 0);
+
+		track->started_ns = MonotonicNs();
+		if (NyceError(StatusPtp[ax]))
+		{
+			track->state = MOVE_IDLE;
+			MoveEmit(ax, MOVE_FAILED, StatusPtp[ax], track->started_ns, track->accepted_ns);
+			logging(ax,(float)StatusPtp[ax],"SacPointToPoint failed","MoveEventIssued");  ////////////////log
+		}
+		else
+		{
+			track->state = MOVE_MOVING;
+			g_moving |= AXIS_BIT(ax);
+			MoveEmit(ax, MOVE_STARTED, StatusPtp[ax], track->started_ns, track->accepted_ns);
+		}
+	}
+}
+
+/**
+ *  @brief  Report the moving axes that reached their position. Once per control cycle.
+ */
+void MoveEventPoll(void)
+{
+	int ax;
+	uint64_t now;
+	MOVE_TRACK *track;
+
+	if (g_moving == 0)
+	{
+		return;
+	}
+
+	now = MonotonicNs();
+	for (ax = 0; ax < AxisCount; ax++)
+	{
+		if (!(g_moving & AXIS_BIT(ax)))
+		{
+			continue;
+		}
+
+		track = &g_tracks[ax];
+		if (AxisHasUdsx(ax) ? (*AxisStatFlag(ax) & 0x01) : (now - track->started_ns >= track->planned * 1e9))
+		{
+			track->state = MOVE_IDLE;
+			g_moving &= ~AXIS_BIT(ax);
+			MoveEmit(ax, MOVE_IN_POSITION, NYCE_OK, now, track->started_ns);
+		}
+	}
+}
+
+/**
+ *  @brief  Send the queued events to the subscribed clients. Events are consumed without subscribers too.
+ */
+void MoveEventDrain(void)
+{
+	unsigned int tail, head, count, i;
+	int pointer, subscribed;
+
+	subscribed = TelemSubscriberCount(TELEM_SUB_MOVE) > 0;
+
+	do
+	{
+		tail = g_ringTail;
+		head = __atomic_load_n(&g_ringHead, __ATOMIC_ACQUIRE);
+		count = head - tail;
+		if (count > MOVE_EVENT_BULK)
+		{
+			count = MOVE_EVENT_BULK;
+		}
+
+		for (i = 0; i < count; i++)
+		{
+			g_bulk.events[i] = g_ring[(tail + i) & (MOVE_EVENT_RING - 1)];
+		}
+		__atomic_store_n(&g_ringTail, tail + count, __ATOMIC_RELEASE);
+
+		if (count > 0 && subscribed)
+		{
+			g_bulk.header.count = count;
+			g_bulk.header.dropped = __atomic_load_n(&g_dropped, __ATOMIC_RELAXED);
+
+			pointer = 0;
+			rushMakeBuffer(g_bulkFrame, (char*)&g_bulk, &pointer,
+						   sizeof(MOVE_EVENT_HEADER) + count * sizeof(MOVE_EVENT), E_MOVE_EVENT);
+			TelemBroadcast(TELEM_SUB_MOVE, g_bulkFrame, pointer);
+		}
+	} while (count == MOVE_EVENT_BULK);
+}
@@ -0,0 +1,74 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Move lifecycle events pushed to the clients subscribed with E_MOVE_SUB.
+ *
+ *  Every move planned by profile.c is reported as
+ *
+ *      MOVE_ACCEPTED     planned by the control thread, planned is the duration of the move, as stretched
+ *                        by its sync group; queued with MOVE_STARTED or MOVE_FAILED, timestamped when planned
+ *      MOVE_STARTED      SacPointToPoint returned without error, actual is the time since MOVE_ACCEPTED
+ *      MOVE_FAILED       SacPointToPoint returned status, the move is dropped
+ *      MOVE_IN_POSITION  the axis reports in position (STAT_FLG 0x01), actual is the time since MOVE_STARTED
+ *
+ *  Axes without a UDSX have no in position flag; their MOVE_IN_POSITION follows the planned duration.
+ *  A new move of an axis replaces the one it tracks without an event for the old one.
+ *
+ *  The control thread queues the events in a single-producer/single-consumer ring, the reactor sends them
+ *  in E_MOVE_EVENT frames, a MOVE_EVENT_HEADER followed by count MOVE_EVENTs. While a client is
+ *  subscribed the reactor wakes at least every TELEM_PUSH_LATENCY_MS, so an event reaches it without
+ *  waiting for the next request of some client.
+ */
+
+#ifndef _RUSH_MOVE_EVENT_H_
+#define _RUSH_MOVE_EVENT_H_
+
+#include <stdint.h>
+
+#define MOVE_EVENT_RING			256		/* events, must be a power of two */
+#define MOVE_EVENT_BULK			32		/* events per E_MOVE_EVENT frame */
+
+/* MOVE_EVENT types */
+#define MOVE_ACCEPTED			0
+#define MOVE_STARTED			1
+#define MOVE_FAILED				2
+#define MOVE_IN_POSITION		3
+
+/**
+ * @brief   One step of the life of a move.
+ */
+typedef struct move_event
+{
+	uint64_t			timestamp_ns;		/**< CLOCK_MONOTONIC */
+	uint32_t			move;				/**< Move number of the axis, the same for all events of a move */
+	int32_t				axis;
+	int32_t				type;				/**< MOVE_ACCEPTED, MOVE_STARTED, MOVE_FAILED or MOVE_IN_POSITION */
+	int32_t				status;				/**< NYCE_STATUS of SacPointToPoint, MOVE_STARTED and MOVE_FAILED */
+	double				position;			/**< Target of the move */
+	float				planned;			/**< Planned duration of the move in seconds */
+	float				actual;				/**< Seconds since the previous event of the move, 0 for MOVE_ACCEPTED */
+} MOVE_EVENT;
+
+/**
+ * @brief   Header of an E_MOVE_EVENT frame, followed by count MOVE_EVENTs.
+ */
+typedef struct move_event_header
+{
+	uint32_t			count;
+	uint32_t			dropped;			/**< Events lost because the ring was full, since start */
+} MOVE_EVENT_HEADER;
+
+void MoveEventAccepted(int ax);
+void MoveEventIssued(void);
+void MoveEventPoll(void);
+void MoveEventDrain(void);
+
+#endif
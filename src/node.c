@@ -0,0 +1,596 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Node table, see node.h. Runs on the main thread unless noted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sysapi.h>
+#include <udsxapi.h>
+
+#include "rushEmb.h"
+#include "axisRegistry.h"
+#include "node.h"
+#include "control.h"
+#include "monotonic.h"
+
+/*
+ * User defined errors.
+ */
+#define USR_ERR_FAILED_TO_CREATE_SHM        ((NYCE_STATUS)((NYCE_ERROR_MASK)|((N4K_SS_USR<<NYCE_SUBSYS_SHIFT)|0)))
+#define USR_ERR_FAILED_TO_RESIZE_SHM        ((NYCE_STATUS)((NYCE_ERROR_MASK)|((N4K_SS_USR<<NYCE_SUBSYS_SHIFT)|1)))
+#define USR_ERR_FAILED_TO_MAP_SHM           ((NYCE_STATUS)((NYCE_ERROR_MASK)|((N4K_SS_USR<<NYCE_SUBSYS_SHIFT)|2)))
+
+NODE Nodes[NODE_MAX];
+int NodeCount = 1;
+
+/**
+ * @brief   Work of one node thread in NodeConnectAll and NodeApplySettings.
+ */
+typedef struct node_job
+{
+	pthread_t			thread;
+	NODE*				node;
+	int					started;
+	const AXIS_SETTING*	setting;
+	NYCE_STATUS			status;
+	long				elapsed_ns;
+} NODE_JOB;
+
+
+/**
+ *  @brief  Run job on a thread per node, or in place when the thread cannot be created, and wait for all.
+ */
+static void NodeRunJobs(NODE_JOB *jobs, int count, void* (*job)(void*))
+{
+	int n;
+	pthread_attr_t attr;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, NODE_THREAD_STACK_SIZE);
+
+	for (n = 0; n < count; n++)
+	{
+		if (jobs[n].node == NULL)
+		{
+			continue;
+		}
+		jobs[n].started = (pthread_create(&jobs[n].thread, &attr, job, &jobs[n]) == 0);
+		if (!jobs[n].started)
+		{
+			job(&jobs[n]);
+		}
+	}
+
+	pthread_attr_destroy(&attr);
+
+	for (n = 0; n < count; n++)
+	{
+		if (jobs[n].started)
+		{
+			pthread_join(jobs[n].thread, NULL);
+		}
+	}
+}
+
+/**
+ *  @brief  Whether an address is the machine the server runs on.
+ */
+static int NodeIsLocal(const char *address)
+{
+	return strcmp(address, "localhost") == 0 || strncmp(address, "127.", 4) == 0;
+}
+
+/**
+ *  @brief  Index of the node listed with an address before node count, -1 for none.
+ */
+static int NodeFind(const char *address, int count)
+{
+	int n;
+
+	for (n = 0; n < count; n++)
+	{
+		if (strcmp(Nodes[n].address, address) == 0 || (Nodes[n].local && NodeIsLocal(address)))
+		{
+			return n;
+		}
+	}
+	return -1;
+}
+
+/**
+ *  @brief  Read the node table from NODE_ENV.
+ *
+ *  @return Number of nodes.
+ */
+int NodeInit(void)
+{
+	const char *env = getenv(NODE_ENV);
+	char list[NODE_MAX * 112];
+	char *entry, *save, *shm;
+	NODE *node;
+	int n;
+
+	memset(Nodes, 0, sizeof(Nodes));
+	NodeCount = 0;
+
+	snprintf(list, sizeof(list), "%s", env ? env : "localhost");
+	for (entry = strtok_r(list, ",", &save); entry && NodeCount < NODE_MAX; entry = strtok_r(NULL, ",", &save))
+	{
+		node = &Nodes[NodeCount];
+
+		shm = strchr(entry, '/');
+		if (shm)
+		{
+			*shm++ = 0;
+		}
+
+		//a second entry would connect and start the UDSX of the same NYCe node twice
+		n = NodeFind(entry, NodeCount);
+		if (n >= 0)
+		{
+			printf("node %s skipped, same node as node %d\n", entry, n);
+			continue;
+		}
+
+		node->shmDescriptor = -1;
+		node->local = NodeIsLocal(entry);
+		snprintf(node->address, sizeof(node->address), "%s", entry);
+		if (node->local)
+		{
+			snprintf(node->shmName, sizeof(node->shmName), "%s", shm ? shm : NODE_SHM_NAME);
+		}
+
+		printf("node %d: %s shm %s\n", NodeCount, node->address, node->local ? node->shmName : "none, remote node");
+		NodeCount++;
+	}
+
+	if (NodeCount == 0)
+	{
+		//empty NODE_ENV, fall back to the single local node
+		Nodes[0].shmDescriptor = -1;
+		Nodes[0].local = 1;
+		strcpy(Nodes[0].address, "localhost");
+		strcpy(Nodes[0].shmName, NODE_SHM_NAME);
+		NodeCount = 1;
+	}
+
+	return NodeCount;
+}
+
+static void* NodeConnectFunc(void *arg)
+{
+	NODE_JOB *job = arg;
+	uint64_t start = MonotonicNs();
+
+	job->status = NhiConnect(job->node->address, &job->node->id);
+	job->node->connected = NyceSuccess(job->status);
+	job->elapsed_ns = MonotonicSince(start);
+	return NULL;
+}
+
+/**
+ *  @brief  Connect every node of the table concurrently.
+ *
+ *  @return Status of node 0; the server cannot run without it, the other nodes are only logged.
+ */
+NYCE_STATUS NodeConnectAll(void)
+{
+	NODE_JOB jobs[NODE_MAX];
+	int n;
+
+	memset(jobs, 0, sizeof(jobs));
+	for (n = 0; n < NodeCount; n++)
+	{
+		jobs[n].node = &Nodes[n];
+	}
+
+	NodeRunJobs(jobs, NodeCount, NodeConnectFunc);
+
+	for (n = 0; n < NodeCount; n++)
+	{
+		logging(n,(float)(jobs[n].elapsed_ns / 1000000.0),Nodes[n].address,NyceGetStatusString(jobs[n].status));  ////////////////log
+	}
+
+	nodeId = Nodes[0].id;
+	return jobs[0].status;
+}
+
+void NodeDisconnectAll(void)
+{
+	NYCE_STATUS retVal;
+	int n;
+
+	for (n = 0; n < NodeCount; n++)
+	{
+		if (Nodes[n].connected)
+		{
+			retVal = NhiDisconnect(Nodes[n].id);
+			Nodes[n].connected = 0;
+			if (NyceError(retVal))
+			{
+				printf("NhiDisconnect %s Error %s\n", Nodes[n].address, NyceGetStatusString(retVal));
+			}
+		}
+	}
+}
+
+/**
+ *  @brief  Node owning an axis of the registry.
+ *
+ *  @return -1 when no node owns the axis.
+ */
+int NodeOfAxis(int ax)
+{
+	int n = ax / AXIS_LEGACY_COUNT;
+
+	return (ax >= 0 && n < NodeCount) ? n : -1;
+}
+
+/**
+ *  @brief  Shared memory of the node owning an axis, read once so it cannot change under the caller.
+ *
+ *  @return NULL when the node has no shared memory or no node owns the axis.
+ */
+SHMEM_DATA* NodeShmOfAxis(int ax)
+{
+	int n = NodeOfAxis(ax);
+
+	return (n >= 0) ? __atomic_load_n(&Nodes[n].shm, __ATOMIC_ACQUIRE) : NULL;
+}
+
+/**
+ *  @brief  Close the shared memory of a node.
+ */
+static void NodeUnmapShm(NODE *node)
+{
+    SHMEM_DATA *shm = node->shm;
+
+    /*
+     * Withdraw the pointers before the memory goes away.
+     */
+    __atomic_store_n(&node->shm, NULL, __ATOMIC_RELEASE);
+    if (node == &Nodes[0])
+    {
+    	__atomic_store_n(&pShmem_data, NULL, __ATOMIC_RELEASE);
+    	g_sharedMemorySize = 0;
+    }
+
+    if (shm)
+    {
+        /*
+         * If the counter is mapped we must unmap it.
+         */
+        (void)munmap(shm, sizeof(*shm));
+        node->shmSize = 0;
+    }
+
+    if (node->shmDescriptor != -1)
+    {
+        /*
+         * When the descriptor is still open we need to close it.
+         */
+        (void)close(node->shmDescriptor);
+        node->shmDescriptor = -1;
+
+        if (node->shmCreated)
+        {
+            /*
+             * Finally, the file that was created must be removed.
+             */
+            (void)shm_unlink(node->shmName);
+        }
+    }
+}
+
+/**
+ *  @brief  Map the shared memory of a node.
+ *
+ *  @param[in]  create       Whether or not the application may create the shared memory file if it does not exist.
+ *  @return     Status of the success of creating the shared memory.
+ */
+static NYCE_STATUS NodeMapShm(NODE *node, BOOL create)
+{
+    NYCE_STATUS retVal = NYCE_OK;
+    SHMEM_DATA *shm;
+    struct stat st;
+
+    /*
+     * Create shared memory object.
+     */
+    node->shmDescriptor = shm_open(node->shmName, O_RDWR | (create ? O_CREAT : 0), S_IRUSR | S_IWUSR);
+    if (node->shmDescriptor != -1)
+    {
+        node->shmCreated = create;
+
+        /*
+         *  Set its size to the size of the data.
+         */
+        if (!create ||
+            (ftruncate(node->shmDescriptor, sizeof(SHMEM_DATA)) == 0))
+        {
+            /*
+             * Map shared memory object.
+             */
+            shm = mmap(NULL, sizeof(SHMEM_DATA),
+                       PROT_READ | PROT_WRITE, MAP_SHARED,
+                       node->shmDescriptor, 0);
+            if (shm == MAP_FAILED)
+            {
+                retVal = USR_ERR_FAILED_TO_MAP_SHM;
+            }
+            else
+            {
+                if (create)
+                {
+                    memset(shm, 0, sizeof(SHMEM_DATA));
+                }
+
+                /*
+                 * Remember how much of the data the UDSX actually provides.
+                 */
+                node->shmSize = (fstat(node->shmDescriptor, &st) == 0) ? (size_t)st.st_size : 0;
+                __atomic_store_n(&node->shm, shm, __ATOMIC_RELEASE);
+
+                if (node == &Nodes[0])
+                {
+                	g_sharedMemorySize = node->shmSize;
+                	__atomic_store_n(&pShmem_data, shm, __ATOMIC_RELEASE);
+                }
+            }
+        }
+        else
+        {
+            retVal = USR_ERR_FAILED_TO_RESIZE_SHM;
+        }
+
+        if (NyceError(retVal))
+        {
+            /*
+             * If an error occurred we must close the descriptor again.
+             */
+            NodeUnmapShm(node);
+        }
+    }
+    else
+    {
+        retVal = USR_ERR_FAILED_TO_CREATE_SHM;
+    }
+
+    return retVal;
+}
+
+/**
+ *  @brief  Log the axes whose name or type differs from the setting of the running UDSX.
+ */
+static void NodeLogSettingDiff(NODE *node, const AXIS_SETTING *setting)
+{
+	int i, first = (node - Nodes) * AXIS_LEGACY_COUNT;
+	const char *oldName[AXIS_LEGACY_COUNT] = AXIS_NAME_TABLE(&node->udsxSetting);
+	const char *newName[AXIS_LEGACY_COUNT] = AXIS_NAME_TABLE(setting);
+
+	for (i = 0; i < AXIS_LEGACY_COUNT; i++)
+	{
+		if (node->udsxSetting.Shared_AxisType[i] != setting->Shared_AxisType[i] || strcmp(oldName[i], newName[i]) != 0)
+		{
+			logging(first + i,(float)setting->Shared_AxisType[i],"axis setting changed, UDSX restart",newName[i]);  ////////////////log
+		}
+	}
+}
+
+/**
+ *  @brief  Stop the UDSX of a node and unmap its shared memory.
+ */
+void NodeStopUdsx(NODE *node)
+{
+	NYCE_STATUS return_stat;
+
+	NodeUnmapShm(node);
+	node->udsxRunning = 0;
+
+	if (node->connected)
+	{
+	    return_stat = NhiUdsxStop(node->id);
+	    logging(node - Nodes,(float)return_stat,"NhiUdsxStop",node->address);  ////////////////log
+	}
+}
+
+/**
+ *  @brief  Restart the UDSX of a node with a new setting and map its shared memory. Node thread.
+ */
+static void* NodeStartFunc(void *arg)
+{
+	NODE_JOB *job = arg;
+	NODE *node = job->node;
+	uint64_t start = MonotonicNs();
+	int i;
+
+	if (node->udsxRunning)
+	{
+		NodeLogSettingDiff(node, job->setting);
+	}
+	NodeStopUdsx(node);
+
+	job->status = NhiUdsxStart(node->id, NODE_UDSX_PATH, (void*)job->setting, (uint32_t)sizeof(*job->setting));
+	if (NyceSuccess(job->status))
+	{
+		node->udsxSetting = *job->setting;
+		node->udsxRunning = 1;
+		printf("UDSX started successfully on %s.\n", node->address);
+	}
+
+	//Initialize the shared memory. It is a POSIX shm of this machine, a remote node has none.
+	if (node->local)
+	{
+		job->status = NodeMapShm(node, FALSE);
+		if (NyceError(job->status))
+		{
+			printf("Initialize %s Error %s\n", node->shmName, NyceGetStatusString(job->status));
+		}
+		else
+		{
+			const char *shmName[AXIS_LEGACY_COUNT] = AXIS_NAME_TABLE(node->shm);
+
+			for (i = 0; i < AXIS_LEGACY_COUNT; i++)
+			{
+				printf("axis name %s ",shmName[i]);
+				printf("axis type %d \n",node->shm->Shared_AxisType[i]);
+			}
+		}
+	}
+	else
+	{
+		logging(node - Nodes,0,"remote node, no shared memory",node->address);  ////////////////log
+	}
+
+	job->elapsed_ns = MonotonicSince(start);
+	return NULL;
+}
+
+/**
+ *  @brief  Bring the UDSX of every node in line with settings[node].
+ *
+ *  A UDSX already running with the same setting keeps running with its shared memory (warm restart);
+ *  the others are (re)started concurrently.
+ */
+void NodeApplySettings(const AXIS_SETTING *settings)
+{
+	NODE_JOB jobs[NODE_MAX];
+	NODE *node;
+	int n, restarts = 0;
+
+	memset(jobs, 0, sizeof(jobs));
+	for (n = 0; n < NodeCount; n++)
+	{
+		node = &Nodes[n];
+		if (!node->connected)
+		{
+			continue;
+		}
+
+		if (node->udsxRunning && (node->shm || !node->local) && memcmp(&node->udsxSetting, &settings[n], sizeof(settings[n])) == 0)
+		{
+			logging(n,1,"UDSX kept, axis setting unchanged",node->address);  ////////////////log
+			continue;
+		}
+
+		jobs[n].node = node;
+		jobs[n].setting = &settings[n];
+		restarts++;
+	}
+
+	//the shared memory of a restarted node is unmapped and mapped again
+	if (restarts)
+	{
+		ControlPause();
+		ReactorPause();
+		NodeRunJobs(jobs, NodeCount, NodeStartFunc);
+		ReactorResume();
+		ControlResume();
+	}
+
+	for (n = 0; n < NodeCount; n++)
+	{
+		if (jobs[n].node)
+		{
+			logging(n,(float)(jobs[n].elapsed_ns / 1000000.0),"UDSX start ms",NyceGetStatusString(jobs[n].status));  ////////////////log
+		}
+	}
+}
+
+/**
+ *  @brief  Copy the global CTR_FLG block and the parameters of their axes to the nodes after node 0. Control thread.
+ *
+ *  Node 0 gets Shared_CtrFlag from NyceMainLoop.
+ */
+void NodeMirrorCtr(const float *ctr)
+{
+	SHMEM_DATA *shm;
+	int n;
+
+	for (n = 1; n < NodeCount; n++)
+	{
+		shm = __atomic_load_n(&Nodes[n].shm, __ATOMIC_ACQUIRE);
+		if (shm)
+		{
+			memcpy(&shm->Shared_CtrFlag[10], &ctr[10], 10 * sizeof(float));
+			AxisParamsToCtr(n * AXIS_LEGACY_COUNT, shm->Shared_CtrFlag);
+		}
+	}
+}
+
+/**
+ *  @brief  Copy one channel of a node's shared memory, between two even generations when its UDSX keeps them.
+ */
+static int NodeReadChannel(const NODE *node, const SHMEM_DATA *shm, int channel, void *dst, const void *src, size_t size)
+{
+	unsigned int gen;
+
+	if (node->shmSize < sizeof(SHMEM_DATA) || shm->gen_magic != SHM_GEN_MAGIC)
+	{
+		memcpy(dst, src, size);
+		return 1;
+	}
+	return ShmReadChannel(shm, channel, dst, src, size, &gen);
+}
+
+/**
+ *  @brief  Copy the status of a node for E_NODE_STAT and the status reply. Reactor thread.
+ *
+ *  The arrays are read like the telemetry channels, each a consistent copy. Without a shared memory, or when
+ *  the UDSX kept writing it, shared is 0, STAT_FLG holds the status flags of the registry and the rest is 0.
+ *
+ *  @return 0 when the node does not exist.
+ */
+int NodeReadStatus(int n, NODE_STATUS *status)
+{
+	NODE *node;
+	SHMEM_DATA *shm;
+	int i;
+
+	if (n < 0 || n >= NodeCount)
+	{
+		return 0;
+	}
+
+	node = &Nodes[n];
+	memset(status, 0, sizeof(*status));
+	status->node = n;
+	status->connected = node->connected;
+	status->udsxRunning = node->udsxRunning;
+	status->firstAxis = n * AXIS_LEGACY_COUNT;
+
+	shm = __atomic_load_n(&node->shm, __ATOMIC_ACQUIRE);
+	if (shm)
+	{
+		status->shared = NodeReadChannel(node, shm, SHM_CH_STAT_FLG, status->STAT_FLG, shm->STAT_FLG, sizeof(status->STAT_FLG))
+					  && NodeReadChannel(node, shm, SHM_CH_VC_POS, status->VC_POS, shm->VC_POS, sizeof(status->VC_POS))
+					  && NodeReadChannel(node, shm, SHM_CH_NET_CURRENT, status->NET_CURRENT, shm->NET_CURRENT, sizeof(status->NET_CURRENT));
+	}
+
+	if (!status->shared)
+	{
+		memset(status->VC_POS, 0, sizeof(status->VC_POS));
+		memset(status->NET_CURRENT, 0, sizeof(status->NET_CURRENT));
+		for (i = 0; i < AXIS_LEGACY_COUNT && status->firstAxis + i < AxisCount; i++)
+		{
+			status->STAT_FLG[i] = *AxisStatFlag(status->firstAxis + i);
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,95 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Node table: the NYCe nodes driven by the server, each with its own UDSX and shared memory.
+ *
+ *  The nodes are listed in NODE_ENV as "address,address,...", node 0 first; without it the server drives
+ *  the single node "localhost" as before. A node is listed once, a second entry for the same address, or a
+ *  second local one, is skipped. Every node owns AXIS_LEGACY_COUNT axes of the registry, node n the axes
+ *  n * AXIS_LEGACY_COUNT and up; they are the axes of the AXIS_SETTING its UDSX is started with.
+ *
+ *  Nodes are connected and their UDSX started concurrently, one thread per node. A UDSX is only restarted
+ *  when the setting of its own axes changed. While a shared memory is unmapped and mapped again the control
+ *  thread and the reactor are paused, so neither uses a stale shm.
+ *
+ *  The shared memory is a POSIX shm of the machine the server runs on, so only the local node ("localhost"
+ *  or 127.x) has one: NODE_SHM_NAME, the name its UDSX creates, or the name after a '/', as in
+ *  RUSH_NODES=localhost/mycounter,10.0.0.2. The UDSX is not told the name. A remote node has no status
+ *  channel: its axes have the registry copy of STAT_FLG and no VC_POS or NET_CURRENT, AxisHasUdsx is 0 for
+ *  them, so their moves are in position when their planned duration is over.
+ *
+ *  Node 0 is the legacy node: pShmem_data and nodeId are its shared memory and node id, and the legacy
+ *  sections of the status reply, the trace ring, Modbus and the UDSX cycle wait use it. Every node is
+ *  observed with E_NODE_STAT (payload int node, reply NODE_STATUS), and with more than one node the status
+ *  reply carries a NODE_STATUS section for each. CTR_FLG and the axis parameters are mirrored to every node
+ *  with a shared memory.
+ */
+
+#ifndef _RUSH_NODE_H_
+#define _RUSH_NODE_H_
+
+#include <stddef.h>
+#include <nycedefs.h>
+#include "rushEmb.h"
+
+#define NODE_MAX				4
+#define NODE_ENV				"RUSH_NODES"
+#define NODE_SHM_NAME			"mycounter"		/* shared memory the UDSX of the local node creates */
+#define NODE_UDSX_PATH			"/home/user/librushUDSX.so"
+#define NODE_THREAD_STACK_SIZE	(64 * 1024)
+
+/**
+ * @brief   One NYCe node with its UDSX and shared memory.
+ */
+typedef struct node
+{
+	char				address[80];
+	int					local;			/**< Runs on this machine, the only node with a shared memory */
+	char				shmName[32];
+	unsigned int		id;
+	int					connected;
+	SHMEM_DATA*			shm;			/**< NULL until the UDSX runs and the memory is mapped */
+	int					shmDescriptor;
+	BOOL				shmCreated;
+	size_t				shmSize;		/**< Smaller than SHMEM_DATA when the UDSX predates the newer fields */
+	int					udsxRunning;
+	AXIS_SETTING		udsxSetting;	/**< Setting the running UDSX was started with */
+} NODE;
+
+/**
+ * @brief   E_NODE_STAT reply and status reply section, the status of one node.
+ */
+typedef struct node_status
+{
+	int					node;
+	int					connected;
+	int					udsxRunning;
+	int					firstAxis;		/**< Registry id of STAT_FLG[0] */
+	int					shared;			/**< The arrays were read from the shared memory, see NodeReadStatus */
+	unsigned int		STAT_FLG[10];
+	float				VC_POS[20];
+	float				NET_CURRENT[10];
+} NODE_STATUS;
+
+extern NODE Nodes[NODE_MAX];
+extern int NodeCount;
+
+int NodeInit(void);
+NYCE_STATUS NodeConnectAll(void);
+void NodeDisconnectAll(void);
+int NodeOfAxis(int ax);
+SHMEM_DATA* NodeShmOfAxis(int ax);
+void NodeApplySettings(const AXIS_SETTING *settings);
+void NodeStopUdsx(NODE *node);
+void NodeMirrorCtr(const float *ctr);
+int NodeReadStatus(int node, NODE_STATUS *status);
+
+#endif
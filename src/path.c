@@ -0,0 +1,193 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Waypoint paths, see path.h.
+ *
+ *  PathLoad runs on the reactor and leaves the path in the upload slot of the axis; the control thread
+ *  takes it over in PathPoll, which then owns the running paths alone.
+ */
+
+#include <string.h>
+
+#include "rushEmb.h"
+#include "path.h"
+#include "axisRegistry.h"
+#include "handoff.h"
+#include "monotonic.h"
+
+typedef struct path
+{
+	int					count;
+	int					repeat;
+	PATH_POINT			points[PATH_MAX_POINTS];
+} PATH;
+
+typedef struct path_run
+{
+	PATH				path;
+	int					next;				/**< Point the next segment moves to */
+	int					started;			/**< A segment was issued */
+	uint64_t			start_ns;			/**< Issue time of the running segment */
+	float				blend;				/**< Blend of the running segment */
+} PATH_RUN;
+
+static PATH					g_upload[AXIS_MAX];		// reactor, under g_handoff
+static HANDOFF				g_handoff = HANDOFF_INITIALIZER;
+
+static PATH_RUN				g_runs[AXIS_MAX];		// control thread
+static AXIS_MASK			g_active = 0;
+
+
+/**
+ *  @brief  Store a path for the axis, taken over in the next control cycle. Reactor thread.
+ *
+ *  @return 0 when the axis or the point count is out of range.
+ */
+int PathLoad(const PATH_HEADER *header, const PATH_POINT *points)
+{
+	int ax = header->axis;
+
+	if (ax < 0 || ax >= AxisCount || header->count < 0 || header->count > PATH_MAX_POINTS)
+	{
+		return 0;
+	}
+
+	HandoffLock(&g_handoff);
+	g_upload[ax].count = header->count;
+	g_upload[ax].repeat = header->repeat;
+	memcpy(g_upload[ax].points, points, header->count * sizeof(PATH_POINT));
+	HandoffPost(&g_handoff, ax);
+	return 1;
+}
+
+/**
+ *  @brief  Stop every path at the start of the next control cycle.
+ */
+void PathClearAll(void)
+{
+	HandoffClear(&g_handoff);
+}
+
+/**
+ *  @brief  The running segment of ax has run its course: its duration is over and, without blend, the axis
+ *          is in position. Axes without shared memory have no in position flag, there the time decides.
+ */
+static int PathSegmentDone(int ax, const PATH_RUN *run)
+{
+	double elapsed = MonotonicSince(run->start_ns) / 1e9;
+
+	if (elapsed < duration[ax] * (1 - run->blend))
+	{
+		return 0;
+	}
+	return run->blend > 0 || !AxisHasUdsx(ax) || (*AxisStatFlag(ax) & 0x01);
+}
+
+/**
+ *  @brief  Take the new uploads over and queue the next segment of every path that is due. Control thread,
+ *          before the AxisCmdQueue is executed.
+ */
+void PathPoll(void)
+{
+	int ax;
+	AXIS_MASK uploads, cancelled;
+	PATH_RUN *run;
+	PATH_POINT *point;
+	AXIS_CMD *cmd;
+
+	if (HandoffCleared(&g_handoff))
+	{
+		g_active = 0;
+	}
+
+	uploads = HandoffTake(&g_handoff);
+	if (uploads)
+	{
+		for (ax = 0; ax < AxisCount; ax++)
+		{
+			if (uploads & AXIS_BIT(ax))
+			{
+				memcpy(&g_runs[ax].path, &g_upload[ax], sizeof(PATH));
+				g_runs[ax].next = 0;
+				g_runs[ax].started = 0;
+				g_runs[ax].blend = 0;
+				g_active &= ~AXIS_BIT(ax);
+				if (g_upload[ax].count > 0)
+				{
+					g_active |= AXIS_BIT(ax);
+				}
+			}
+		}
+		HandoffRelease(&g_handoff);
+	}
+
+	if (g_active == 0)
+	{
+		return;
+	}
+
+	//the host took the axis back
+	cancelled = g_active & AxisCmdQueued();
+	for (ax = 0; ax < AxisCount && cancelled; ax++)
+	{
+		if (cancelled & AXIS_BIT(ax))
+		{
+			logging(ax,(float)g_runs[ax].next,"path cancelled by host command","PathPoll");  ////////////////log
+			cancelled &= ~AXIS_BIT(ax);
+			g_active &= ~AXIS_BIT(ax);
+		}
+	}
+
+	for (ax = 0; ax < AxisCount && g_active; ax++)
+	{
+		run = &g_runs[ax];
+		if (!(g_active & AXIS_BIT(ax)) || SacConnected[ax] != 255 || (run->started && !PathSegmentDone(ax, run)))
+		{
+			continue;
+		}
+
+		if (run->next >= run->path.count)
+		{
+			if (run->path.repeat == 0)
+			{
+				g_active &= ~AXIS_BIT(ax);
+				logging(ax,(float)run->path.count,"path done","PathPoll");  ////////////////log
+				continue;
+			}
+			if (run->path.repeat > 0)
+			{
+				run->path.repeat--;
+			}
+			run->next = 0;
+		}
+
+		if (AxisCmdCount >= AXIS_CMD_QUEUE)
+		{
+			break;
+		}
+
+		point = &run->path.points[run->next++];
+		cmd = &AxisCmdQueue[AxisCmdCount++];
+		cmd->axis = ax;
+		cmd->opcode = OP_MOVE | (point->profile << AXIS_OP_PROFILE_SHIFT);
+		cmd->position = point->position;
+		cmd->distance = point->distance;
+		cmd->duration = point->duration;
+
+		run->blend = (point->blend > 0) ? point->blend : 0;
+		if (run->blend > PATH_MAX_BLEND)
+		{
+			run->blend = PATH_MAX_BLEND;
+		}
+		run->started = 1;
+		run->start_ns = MonotonicNs();
+	}
+}
@@ -0,0 +1,61 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Waypoint paths: a list of targets per axis, moved to one after the other on the box.
+ *
+ *  A path is uploaded with E_AXIS_PATH, a PATH_HEADER followed by its PATH_POINTs, and replaces the path
+ *  the axis was running; a path without points stops it. Every point is one OP_MOVE of the axis with its
+ *  own profile, default distance and duration, so it goes through the handler of the axis like a host
+ *  command and is batched and synchronized with the other moves of its control cycle.
+ *
+ *  The control thread starts the next segment when the current one has run for its duration (as planned
+ *  by profile.c) and the axis reports in position. A segment with a blend fraction instead hands over
+ *  that fraction of its duration early, while the axis still moves, and the drive carries the velocity
+ *  into the next segment. With repeat the path runs again from its first point, -1 without end.
+ *
+ *  A host command for the axis cancels its path, and so does a system stop.
+ */
+
+#ifndef _RUSH_PATH_H_
+#define _RUSH_PATH_H_
+
+#include "rushEmb.h"
+
+#define PATH_MAX_POINTS			64
+#define PATH_MAX_BLEND			0.9f
+
+/**
+ * @brief   E_AXIS_PATH header, followed by count PATH_POINTs.
+ */
+typedef struct path_header
+{
+	int					axis;
+	int					count;				/**< 0 stops the path of the axis */
+	int					repeat;				/**< Further runs of the path, -1 without end */
+} PATH_HEADER;
+
+/**
+ * @brief   One waypoint of a path.
+ */
+typedef struct path_point
+{
+	double				position;			/**< Target, absolute or relative like OP_MOVE of the axis */
+	float				distance;			/**< Default distance of the profile, 0 uses AXIS_PAR_DEF_DISTANCE */
+	float				duration;			/**< Default duration of the profile, 0 uses AXIS_PAR_DEF_DURATION */
+	int					profile;			/**< PROFILE_KIND + 1, 0 uses AXIS_PAR_PROFILE */
+	float				blend;				/**< Fraction of the segment overlapped by the next one, 0 to PATH_MAX_BLEND */
+} PATH_POINT;
+
+int PathLoad(const PATH_HEADER *header, const PATH_POINT *points);
+void PathClearAll(void);
+void PathPoll(void);
+
+#endif
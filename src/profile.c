@@ -0,0 +1,342 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Motion profile engine, see profile.h. Runs on the control thread.
+ */
+
+#include <math.h>
+
+#include "rushEmb.h"
+#include "profile.h"
+#include "ptpBatch.h"
+#include "axisRegistry.h"
+#include "node.h"
+#include "moveEvent.h"
+
+typedef void (*PROFILE_PLANNER)(const AXIS_CMD *cmd);
+
+
+/* axes batched by ProfileStart in this control cycle, for ProfileSyncBatch */
+static AXIS_MASK g_planned = 0;
+
+
+/**
+ *  @brief  n-th root (n 2 or 3) of x >= 0 by Newton iteration; the server does not link libm.
+ */
+static double ProfileRoot(double x, int n)
+{
+	double r, next;
+	int i;
+
+	if (x <= 0)
+	{
+		return 0;
+	}
+
+	r = (x > 1) ? x : 1;			//above the root, from there Newton decreases monotonically
+	for (i = 0; i < 200; i++)
+	{
+		next = r - ((n == 2 ? r * r : r * r * r) - x) / (n == 2 ? 2 * r : 3 * r * r);
+		if (next >= r)
+		{
+			break;
+		}
+		r = next;
+	}
+	return r;
+}
+
+/**
+ *  @brief  Duration of the fastest symmetric move over dist (> 0) within the limits velocity, acceleration
+ *          and jerk, as the point-to-point generator of the drive runs it. A jerk <= 0 is unlimited.
+ */
+static double ProfileMinTime(double dist, double velocity, double acceleration, double jerk)
+{
+	double accTime, peak, jerkTime;
+
+	if (dist <= 0 || velocity <= 0 || acceleration <= 0)
+	{
+		return 0;
+	}
+
+	if (jerk <= 0)
+	{
+		if (dist >= velocity * velocity / acceleration)
+		{
+			return dist / velocity + velocity / acceleration;
+		}
+		return 2 * ProfileRoot(dist / acceleration, 2);
+	}
+
+	//acceleration phase to velocity, with or without a constant acceleration part
+	if (velocity * jerk >= acceleration * acceleration)
+	{
+		accTime = velocity / acceleration + acceleration / jerk;
+	}
+	else
+	{
+		accTime = 2 * ProfileRoot(velocity / jerk, 2);
+	}
+
+	if (dist >= velocity * accTime)
+	{
+		return accTime + dist / velocity;
+	}
+
+	//velocity not reached: peak velocity with full acceleration, else a pure jerk move
+	peak = acceleration * (ProfileRoot(acceleration * acceleration / (jerk * jerk) + 4 * dist / acceleration, 2) - acceleration / jerk) / 2;
+	if (peak * jerk >= acceleration * acceleration)
+	{
+		return 2 * (peak / acceleration + acceleration / jerk);
+	}
+
+	jerkTime = ProfileRoot(dist / (2 * jerk), 3);
+	return 4 * jerkTime;
+}
+
+
+/*
+ * Kernels: velocity, acceleration and jerk of a move of axis ax over dist (> 0) in time (> 0).
+ * A jerk of -1 is infinite.
+ */
+static inline void ProfileParabolic(int ax, double dist, double time, SAC_PTP_PARS *pars)
+{
+	pars->velocity		= dist / (time / 2);
+	pars->acceleration	= pars->velocity / (time / 2);
+	pars->jerk			= -1;
+}
+
+static inline void ProfileMinJerk(int ax, double dist, double time, SAC_PTP_PARS *pars)
+{
+	pars->velocity		= 2 * dist / time;
+	pars->acceleration	= 4 * pars->velocity / time;
+	pars->jerk			= 4 * pars->acceleration / time;
+}
+
+static inline void ProfileEnergy3rd(int ax, double dist, double time, SAC_PTP_PARS *pars)
+{
+	pars->velocity		= 1.5 * dist / time;
+	pars->acceleration	= 4.5 * pars->velocity / time;
+	pars->jerk			= 9   * pars->acceleration / time;
+}
+
+static inline void ProfileTrapezoidal(int ax, double dist, double time, SAC_PTP_PARS *pars)
+{
+	pars->velocity		= 1.5 * dist / time;
+	pars->acceleration	= pars->velocity / (time / 3);
+	pars->jerk			= -1;
+}
+
+static inline void ProfileSCurve(int ax, double dist, double time, SAC_PTP_PARS *pars)
+{
+	//the acceleration ramps up and down in time/6 each, so the peak is twice the trapezoidal one
+	pars->velocity		= 1.5 * dist / time;
+	pars->acceleration	= 2 * pars->velocity / (time / 3);
+	pars->jerk			= pars->acceleration / (time / 6);
+}
+
+static inline void ProfileTimeOptimal(int ax, double dist, double time, SAC_PTP_PARS *pars)
+{
+	//the drive runs the fastest move within its limits, the duration follows from them
+	if (AxisParam[AXIS_PAR_VMAX][ax] <= 0 || AxisParam[AXIS_PAR_AMAX][ax] <= 0)
+	{
+		ProfileParabolic(ax, dist, time, pars);			//limits not configured
+		return;
+	}
+
+	pars->velocity		= AxisParam[AXIS_PAR_VMAX][ax];
+	pars->acceleration	= AxisParam[AXIS_PAR_AMAX][ax];
+	pars->jerk			= (AxisParam[AXIS_PAR_JMAX][ax] > 0) ? AxisParam[AXIS_PAR_JMAX][ax] : -1;
+}
+
+/**
+ *  @brief  Set point of an axis in the shared memory of its node, the last target when there is none.
+ */
+double ProfileSetPoint(int ax)
+{
+	SHMEM_DATA *shm = NodeShmOfAxis(ax);
+
+	if (shm)
+	{
+		return shm->Shared_SetPointPos[ax % AXIS_LEGACY_COUNT];
+	}
+	return oldPtpPos[ax];
+}
+
+/**
+ *  @brief  Shared pre-processing: distance, ratio and duration of the move of cmd.
+ */
+static inline void ProfilePrepare(const AXIS_CMD *cmd)
+{
+	int ax = cmd->axis;
+	float defDistance = (cmd->distance > 0) ? cmd->distance : AxisParam[AXIS_PAR_DEF_DISTANCE][ax];
+	float defDuration = (cmd->duration > 0) ? cmd->duration : AxisParam[AXIS_PAR_DEF_DURATION][ax];
+
+	if (m_sacPtpPars[ax].positionReference == SAC_ABSOLUTE)
+	{
+		distance[ax] = cmd->position - ProfileSetPoint(ax);
+	}
+	else
+	{
+		distance[ax] = cmd->position;
+	}
+
+	ratio[ax] = fabs(distance[ax]) / defDistance;
+	duration[ax] = defDuration * ratio[ax];
+
+	if (duration[ax] < defDuration)
+	{
+		duration[ax] = defDuration;
+	}
+
+	m_sacPtpPars[ax].position = cmd->position;
+}
+
+/**
+ *  @brief  Shared post-processing: replace zero limits, set duration[ax] to the time the move takes and
+ *          start the move planned in m_sacPtpPars[ax], or leave it to the batch of the control cycle.
+ */
+static inline void ProfileStart(int ax)
+{
+	if (m_sacPtpPars[ax].velocity == 0)
+	{
+		m_sacPtpPars[ax].velocity = 10;
+	}
+
+	if (m_sacPtpPars[ax].acceleration == 0)
+	{
+		m_sacPtpPars[ax].acceleration = 10;
+	}
+
+	if (m_sacPtpPars[ax].jerk == 0)
+	{
+		m_sacPtpPars[ax].jerk = 10;
+	}
+
+	duration[ax] = ProfileMinTime(fabs(distance[ax]), m_sacPtpPars[ax].velocity, m_sacPtpPars[ax].acceleration, m_sacPtpPars[ax].jerk);
+
+	*AxisStatFlag(ax) = 0;
+
+	if (fabs(distance[ax]) <= 1)
+	{
+		*AxisStatFlag(ax) |= 0x01;
+	}
+
+	MoveEventAccepted(ax);
+
+	if (PtpBatchAdd(ax))
+	{
+		g_planned |= AXIS_BIT(ax);
+	}
+	else
+	{
+		StatusPtp[ax] = SacPointToPoint(sacAxis[ax],&m_sacPtpPars[ax]);
+	}
+}
+
+/* one planner per kernel, the kernel inlined between the shared steps */
+#define PROFILE_PLANNER_DEFINE(id, kernel) \
+	static void kernel##Plan(const AXIS_CMD *cmd) \
+	{ \
+		ProfilePrepare(cmd); \
+		kernel(cmd->axis, fabs(distance[cmd->axis]), duration[cmd->axis], &m_sacPtpPars[cmd->axis]); \
+		ProfileStart(cmd->axis); \
+	}
+
+PROFILE_LIST(PROFILE_PLANNER_DEFINE)
+
+#define PROFILE_PLANNER_ENTRY(id, kernel)		[id] = kernel##Plan,
+
+static const PROFILE_PLANNER g_planners[PROFILE_COUNT] = { PROFILE_LIST(PROFILE_PLANNER_ENTRY) };
+
+
+/**
+ *  @brief  Profile kind of a move: the one of the command, else the AXIS_PAR_PROFILE of its axis.
+ *          An unknown kind falls back to PROFILE_PARABOLIC.
+ */
+int ProfileOf(const AXIS_CMD *cmd)
+{
+	int kind = AXIS_CMD_PROFILE(cmd);
+
+	if (kind < 0)
+	{
+		kind = (int)AxisParam[AXIS_PAR_PROFILE][cmd->axis];
+	}
+	if (kind < 0 || kind >= PROFILE_COUNT)
+	{
+		kind = PROFILE_PARABOLIC;
+	}
+	return kind;
+}
+
+/**
+ *  @brief  Plan and start the move of cmd with its profile. The handler has set the position reference.
+ */
+void ProfileExecute(const AXIS_CMD *cmd)
+{
+	g_planners[ProfileOf(cmd)](cmd);
+}
+
+/**
+ *  @brief  Stretch the batched moves of each AXIS_PAR_SYNC_GROUP to the longest one of the group, so they
+ *          finish together. Called before PtpBatchIssue.
+ *
+ *  Scaling the time of a move by k scales its velocity by 1/k, acceleration by 1/k^2 and jerk by 1/k^3,
+ *  so the stretched moves keep the shape of their profile and stay within the limits.
+ */
+void ProfileSyncBatch(void)
+{
+	int ax, other;
+	float group;
+	double longest, k;
+	AXIS_MASK pending = g_planned;
+
+	g_planned = 0;
+
+	for (ax = 0; ax < AxisCount && pending; ax++)
+	{
+		group = AxisParam[AXIS_PAR_SYNC_GROUP][ax];
+		if (!(pending & AXIS_BIT(ax)) || group == 0)
+		{
+			continue;
+		}
+
+		longest = 0;
+		for (other = ax; other < AxisCount; other++)
+		{
+			if ((pending & AXIS_BIT(other)) && AxisParam[AXIS_PAR_SYNC_GROUP][other] == group && duration[other] > longest)
+			{
+				longest = duration[other];
+			}
+		}
+
+		for (other = ax; other < AxisCount; other++)
+		{
+			if (!(pending & AXIS_BIT(other)) || AxisParam[AXIS_PAR_SYNC_GROUP][other] != group)
+			{
+				continue;
+			}
+			pending &= ~AXIS_BIT(other);
+
+			if (duration[other] > 0 && duration[other] < longest)
+			{
+				k = longest / duration[other];
+				m_sacPtpPars[other].velocity /= k;
+				m_sacPtpPars[other].acceleration /= k * k;
+				if (m_sacPtpPars[other].jerk > 0)
+				{
+					m_sacPtpPars[other].jerk /= k * k * k;
+				}
+				duration[other] = longest;
+			}
+		}
+	}
+}
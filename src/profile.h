@@ -0,0 +1,64 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Motion profile engine: plans the point-to-point moves of the axis command handlers.
+ *
+ *  Every profile is the same three steps. The shared pre-processing takes the distance of the move from
+ *  the command (relative) or from the set point of the axis (absolute) and stretches the default duration
+ *  of the axis by the ratio of that distance to the default distance. A kernel, the only part specific to
+ *  a profile, turns distance and duration into velocity, acceleration and jerk. The shared post-processing
+ *  replaces zero limits and starts the move, or adds it to the batch of the control cycle.
+ *
+ *  The kernels are listed once in PROFILE_LIST. Each one is compiled into its own planner with the kernel
+ *  inlined, and ProfileExecute selects the planner by indexing a table, so the path from the handler to
+ *  SacPointToPoint has no branch on the profile kind.
+ *
+ *  The profile of a move is chosen by the command (AXIS_CMD_PROFILE) or, when the command has none, by the
+ *  AXIS_PAR_PROFILE parameter of the axis, set with E_AXIS_PARAM. Parabolic is the default of both.
+ *
+ *  The other profiles fit the move into the default duration scaled by distance. PROFILE_TIME_OPTIMAL
+ *  instead hands the velocity, acceleration and jerk limits of the axis to the drive, which then runs the
+ *  shortest jerk-limited move; without configured limits it plans a parabolic move.
+ *  After planning, duration[ax] is the time the move takes, computed from its limits. Axes sharing a
+ *  nonzero AXIS_PAR_SYNC_GROUP whose moves start in the same control cycle are stretched by
+ *  ProfileSyncBatch to finish with the slowest of them.
+ */
+
+#ifndef _RUSH_PROFILE_H_
+#define _RUSH_PROFILE_H_
+
+#include "rushEmb.h"
+
+/*
+ * X(id, kernel)
+ */
+#define PROFILE_LIST(X) \
+	X(PROFILE_PARABOLIC,	ProfileParabolic)		/* constant acceleration, half the duration each way */ \
+	X(PROFILE_MIN_JERK,		ProfileMinJerk)			/* minimum jerk */ \
+	X(PROFILE_ENERGY_3RD,	ProfileEnergy3rd)		/* energy optimal third order */ \
+	X(PROFILE_TRAPEZOIDAL,	ProfileTrapezoidal)		/* a third of the duration each to accelerate, cruise and brake */ \
+	X(PROFILE_S_CURVE,		ProfileSCurve)			/* trapezoidal with jerk limited acceleration ramps */ \
+	X(PROFILE_TIME_OPTIMAL,	ProfileTimeOptimal)		/* fastest move within AXIS_PAR_VMAX, AXIS_PAR_AMAX and AXIS_PAR_JMAX */
+
+#define PROFILE_ENUM(id, kernel)		id,
+
+enum PROFILE_KIND{
+	PROFILE_LIST(PROFILE_ENUM)
+
+	PROFILE_COUNT
+};
+
+int ProfileOf(const AXIS_CMD *cmd);
+void ProfileExecute(const AXIS_CMD *cmd);
+void ProfileSyncBatch(void);
+double ProfileSetPoint(int ax);
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Per-axis worker pool issuing the moves of a control cycle together, see ptpBatch.h.
+ *
+ *  Everything except the workers runs on the control thread.
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "rushEmb.h"
+#include "ptpBatch.h"
+#include "axisRegistry.h"
+#include "monotonic.h"
+
+typedef struct ptp_worker
+{
+	pthread_t			thread;
+	int					axis;
+	int					started;
+	unsigned int		seen;			/**< Last batch generation looked at */
+} PTP_WORKER;
+
+static PTP_WORKER			g_workers[AXIS_MAX];
+static pthread_mutex_t		g_batchLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t		g_go = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t		g_done = PTHREAD_COND_INITIALIZER;
+static unsigned int			g_generation = 0;
+static int					g_stop = 0;
+static int					g_remaining = 0;
+static AXIS_MASK			g_issueMask = 0;	// axes of the released batch, only changed with g_generation
+
+static int					g_open = 0;		// between PtpBatchBegin and PtpBatchIssue
+static AXIS_MASK			g_mask = 0;		// axes of the open batch
+static uint64_t				g_accepted[AXIS_MAX];	// SacPointToPoint return time per axis, ns
+
+static PTP_BATCH_STATS		g_stats;
+
+
+static void PtpIssueAxis(int ax)
+{
+	StatusPtp[ax] = SacPointToPoint(sacAxis[ax], &m_sacPtpPars[ax]);
+	g_accepted[ax] = MonotonicNs();
+}
+
+static void* PtpWorkerFunc(void *arg)
+{
+	PTP_WORKER *worker = arg;
+	int ax = worker->axis;
+
+	pthread_mutex_lock(&g_batchLock);
+	while (!g_stop)
+	{
+		if (worker->seen == g_generation)
+		{
+			pthread_cond_wait(&g_go, &g_batchLock);
+			continue;
+		}
+
+		worker->seen = g_generation;
+		if (!(g_issueMask & AXIS_BIT(ax)))
+		{
+			continue;
+		}
+
+		pthread_mutex_unlock(&g_batchLock);
+		PtpIssueAxis(ax);
+		pthread_mutex_lock(&g_batchLock);
+
+		if (--g_remaining == 0)
+		{
+			pthread_cond_signal(&g_done);
+		}
+	}
+	pthread_mutex_unlock(&g_batchLock);
+
+	return NULL;
+}
+
+/**
+ *  @brief  Start one worker per axis. Called from the control thread, the workers inherit its scheduling.
+ *
+ *  @return Number of workers running; without any, batches are issued one call after the other.
+ */
+int PtpBatchStart(void)
+{
+	int ax, count = 0;
+	pthread_attr_t attr;
+
+	g_stop = 0;
+	memset(&g_stats, 0, sizeof(g_stats));
+
+	//the default stack of every worker would be locked in memory as a whole
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, PTP_WORKER_STACK_SIZE);
+
+	for (ax = 0; ax < AxisCount && PTP_CONCURRENT; ax++)
+	{
+		g_workers[ax].axis = ax;
+		g_workers[ax].seen = g_generation;
+		g_workers[ax].started = (pthread_create(&g_workers[ax].thread, &attr, PtpWorkerFunc, &g_workers[ax]) == 0);
+		count += g_workers[ax].started;
+	}
+
+	pthread_attr_destroy(&attr);
+	return count;
+}
+
+void PtpBatchStop(void)
+{
+	int ax;
+
+	pthread_mutex_lock(&g_batchLock);
+	g_stop = 1;
+	pthread_cond_broadcast(&g_go);
+	pthread_mutex_unlock(&g_batchLock);
+
+	for (ax = 0; ax < AxisCount; ax++)
+	{
+		if (g_workers[ax].started)
+		{
+			pthread_join(g_workers[ax].thread, NULL);
+			g_workers[ax].started = 0;
+		}
+	}
+}
+
+void PtpBatchBegin(void)
+{
+	g_open = 1;
+	g_mask = 0;
+}
+
+/**
+ *  @brief  Defer the SacPointToPoint of an axis to PtpBatchIssue.
+ *
+ *  @return 0 when no batch is open or the axis already has a move in it; the caller issues the move itself.
+ */
+int PtpBatchAdd(int ax)
+{
+	if (!g_open || (g_mask & AXIS_BIT(ax)))
+	{
+		return 0;
+	}
+
+	g_mask |= AXIS_BIT(ax);
+	return 1;
+}
+
+/**
+ *  @brief  Start every move of the batch and wait until all of them are accepted.
+ */
+void PtpBatchIssue(void)
+{
+	int ax, count = 0, concurrent = 1;
+	double first, last, accepted;
+
+	g_open = 0;
+
+	for (ax = 0; ax < AxisCount; ax++)
+	{
+		if (g_mask & AXIS_BIT(ax))
+		{
+			count++;
+			concurrent &= g_workers[ax].started;
+		}
+	}
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (count > 1 && concurrent)
+	{
+		pthread_mutex_lock(&g_batchLock);
+		g_remaining = count;
+		g_issueMask = g_mask;
+		g_generation++;
+		pthread_cond_broadcast(&g_go);
+		while (g_remaining > 0)
+		{
+			pthread_cond_wait(&g_done, &g_batchLock);
+		}
+		pthread_mutex_unlock(&g_batchLock);
+	}
+	else
+	{
+		for (ax = 0; ax < AxisCount; ax++)
+		{
+			if (g_mask & AXIS_BIT(ax))
+			{
+				PtpIssueAxis(ax);
+			}
+		}
+	}
+
+	if (count > 1)
+	{
+		first = last = -1;
+		for (ax = 0; ax < AxisCount; ax++)
+		{
+			if (g_mask & AXIS_BIT(ax))
+			{
+				accepted = g_accepted[ax] / 1e3;
+				if (first < 0 || accepted < first)
+				{
+					first = accepted;
+				}
+				if (accepted > last)
+				{
+					last = accepted;
+				}
+			}
+		}
+
+		g_stats.batches++;
+		g_stats.skewSum += last - first;
+		if (last - first > g_stats.skewMax)
+		{
+			g_stats.skewMax = last - first;
+		}
+	}
+
+	g_mask = 0;
+}
+
+/**
+ *  @brief  Copy and reset the skew statistics. Control thread only.
+ */
+void PtpBatchTakeStats(PTP_BATCH_STATS *stats)
+{
+	*stats = g_stats;
+	memset(&g_stats, 0, sizeof(g_stats));
+}
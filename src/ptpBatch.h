@@ -0,0 +1,47 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Synchronized start of the point-to-point moves planned in one control cycle.
+ *
+ *  NyceMainLoop used to call SacPointToPoint axis after axis, so when turret and pusher were commanded
+ *  together the last axis started several SAC call latencies after the first. Between PtpBatchBegin and
+ *  PtpBatchIssue the profiles only plan m_sacPtpPars and add their axis to the batch. PtpBatchIssue then
+ *  releases one worker thread per axis with a single broadcast, so all SacPointToPoint calls are in
+ *  flight at the same time, and waits for them to return.
+ *
+ *  The start skew of a batch is the spread of the SacPointToPoint return times, the moment each axis has
+ *  accepted its move. It is accumulated per control statistics window (control.h).
+ */
+
+#ifndef _RUSH_PTP_BATCH_H_
+#define _RUSH_PTP_BATCH_H_
+
+#define PTP_CONCURRENT			1		/* 0 issues a batch from the control thread, one call after the other */
+#define PTP_WORKER_STACK_SIZE	(64 * 1024)	/* locked by mlockall, one per axis */
+
+/**
+ * @brief   Start skew of the batches issued since the last PtpBatchTakeStats, in microseconds.
+ */
+typedef struct ptp_batch_stats
+{
+	unsigned int		batches;		/**< Batches of two or more axes */
+	double				skewSum;
+	double				skewMax;
+} PTP_BATCH_STATS;
+
+int PtpBatchStart(void);
+void PtpBatchStop(void);
+void PtpBatchBegin(void);
+int PtpBatchAdd(int ax);
+void PtpBatchIssue(void);
+void PtpBatchTakeStats(PTP_BATCH_STATS *stats);
+
+#endif
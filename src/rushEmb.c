@@ -25,6 +25,7 @@
 
 #define BIN
 #define DEBUG 0
+#define WARM_RESTART 1	//SYS_STOP keeps the UDSX, shared memory and axis connections for the next init
 
 #include <stdio.h>
 #include <stdint.h>
@@ -32,6 +33,7 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <fcntl.h>           /* For O_* constants */
+#include <sys/stat.h>
 #include <sactypes.h>
 #include "sysapi.h"
 #include "udsxapi.h"
@@ -47,6 +49,22 @@
 
 /* Include MY_UDSX_ARGS type and USR error codes */
 #include "rushEmb.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "modbus.h"
+#include "hostState.h"
+#include "control.h"
+#include "ptpBatch.h"
+#include "axisRegistry.h"
+#include "node.h"
+#include "profile.h"
+#include "path.h"
+#include "moveEvent.h"
+#include "axisStats.h"
+#include "autoTune.h"
+#include "armedMove.h"
+#include "sequence.h"
+#include "monotonic.h"
 #include <stdlib.h>
 #include <signal.h>
 #include <time.h>
@@ -54,47 +72,25 @@
 
 
 
-/*
- * Name of the shared memory file which is located in /dev/shm.
- */
-#define SHM_NAME "mycounter"
+#define UDSX_WAIT_TIMEOUT_US	2000	//longest wait for one UDSX cycle
+#define UDSX_POLL_US			20		//poll interval for a UDSX without the cycle futex
+#define AXIS_CONNECT_THREADS	16		//SacConnect calls running at once
+#define AXIS_CONNECT_STACK_SIZE	(64 * 1024)
+#define REACTOR_PAUSE_POLL_US	1000	//poll interval of a paused reactor and of ReactorPause
 
 #define UNUSED(x) (void)(x)
 
 /*
- * User defined errors.
- */
-#define USR_ERR_FAILED_TO_CREATE_SHM        ((NYCE_STATUS)((NYCE_ERROR_MASK)|((N4K_SS_USR<<NYCE_SUBSYS_SHIFT)|0)))
-#define USR_ERR_FAILED_TO_RESIZE_SHM        ((NYCE_STATUS)((NYCE_ERROR_MASK)|((N4K_SS_USR<<NYCE_SUBSYS_SHIFT)|1)))
-#define USR_ERR_FAILED_TO_MAP_SHM           ((NYCE_STATUS)((NYCE_ERROR_MASK)|((N4K_SS_USR<<NYCE_SUBSYS_SHIFT)|2)))
-#define USR_ERR_NOT_INITIALIZED             ((NYCE_STATUS)((NYCE_ERROR_MASK)|((N4K_SS_USR<<NYCE_SUBSYS_SHIFT)|3)))
-
-/*
- * Administration of the shared memory.
+ * Shared memory of node 0, mapped by node.c.
  */
-int         g_sharedMemoryDescriptor = -1;  // Descriptor to the file.
 SHMEM_DATA* pShmem_data = NULL;              // Pointer to the shared memory data.
-BOOL        g_created = FALSE;              // Flag to remember whether or not the shared memory was created by this process.
+size_t      g_sharedMemorySize = 0;         // Size of the file, smaller than SHMEM_DATA when the UDSX predates the newer fields.
 
-/**
- *  @brief  Initialize the shared memory.
- *
- *  @param[in]  create       Whether or not the application may create the shared memory file if it does not exist.
- *  @return     Status of the success of creating the shared memory.
- */
-static NYCE_STATUS Initialize(BOOL create);
 
-/**
- *  @brief  Terminate the shared memory.
- */
-static void Terminate(void);
-
-
-//nyce node
+//nyce node 0, see node.h
 unsigned int    nodeId,sysnodeId;
 
 //mutex
-pthread_mutex_t lock;
 
 volatile sig_atomic_t g_stop;
 
@@ -102,6 +98,74 @@ char sys_case;
 char logstr[80];
 pthread_t updateThread;
 
+/*
+ * Shared state declared in rushEmb.h.
+ */
+unsigned int		OLD_STAT_FLG[10];
+float				OLD_NET_CURRENT[10];
+float				OLD_CMD_FLG[10];
+
+int resp_cmd;
+float 				FORCE_LIMIT[10];
+
+float CMD_FLG[10];
+float CTR_FLG[80];
+char  AXS_NAM0[20];
+char  AXS_NAM1[20];
+char  AXS_NAM2[20];
+char  AXS_NAM3[20];
+char  AXS_NAM4[20];
+char  AXS_NAM5[20];
+char  AXS_NAM6[20];
+char  AXS_NAM7[20];
+char  AXS_NAM8[20];
+char  AXS_NAM9[20];
+int   AXS_TYPE[10];
+
+
+float LAST_VC_POS[20];
+unsigned int LAST_STAT_FLG[10];
+
+AXIS_CMD AxisCmdQueue[AXIS_CMD_QUEUE];
+int AxisCmdCount;
+static int CmdStaged;
+
+/* Moves written to the shared memory that the UDSX has not taken over yet, see UdsxTookOver */
+static int UdsxPending;
+static unsigned int UdsxPendingCycle;
+static uint64_t UdsxPendingSince;
+
+/* Main thread -> reactor pause handshake, see ReactorPause */
+static int ReactorPauseDepth;
+static unsigned int ReactorPauseGen;
+static unsigned int ReactorPauseRequest;
+static unsigned int ReactorPauseAck;
+static int ReactorStopped = 1;	//no reactor thread running
+
+float SPEED_FACTOR;
+
+int Init;
+int Ready;
+int stop_eth;
+
+FILE *logfile;
+char oldlogmsg[180];
+
+int debug;
+
+int master_socket[max_ports];
+int client_socket[max_clients];
+int server_port_list[max_clients];
+int ports[max_ports];
+fd_set readfds;
+char nodeAddress[80];
+
+static void onData(dyad_Event *e);
+static void onAccept(dyad_Event *e);
+static void onError(dyad_Event *e);
+static void onReady(dyad_Event *e);
+static void onClose(dyad_Event *e);
+
 /**
  *  @brief  Interrupt signal handler for catching Ctrl-C
  *
@@ -113,22 +177,71 @@ void IntHandler(int signum)
 {
     UNUSED(signum);
     g_stop = 1;
+    HostPostEvent();
 }
 
 void updateThreadFunc(void)
 {
 	static int i;
+	unsigned int pause;
 	while(g_stop == 0)
 	{
 		for(i = 0 ; i < 10;i++)
 		{
+			//held while the main thread remaps the shared memory
+			pause = __atomic_load_n(&ReactorPauseRequest, __ATOMIC_ACQUIRE);
+			if (pause)
+			{
+				__atomic_store_n(&ReactorPauseAck, pause, __ATOMIC_RELEASE);
+				usleep(REACTOR_PAUSE_POLL_US);
+				continue;
+			}
 			if (dyad_getStreamCount() > 0) {
+			TelemBeginCycle();
 			dyad_update();
+			NyceEndCycle();
+			TraceDrain();
+			MoveEventDrain();
 			}
 		}
 		//usleep(10);
 	}
 
+	__atomic_store_n(&ReactorStopped, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  @brief  Hold the reactor between cycles, returns once it runs no cycle anymore. Main thread.
+ *
+ *  A cycle in dyad_update ends after the update timeout at the latest. Calls nest; the reactor runs again
+ *  after the matching ReactorResume.
+ */
+void ReactorPause(void)
+{
+	if (ReactorPauseDepth++ > 0)
+	{
+		return;
+	}
+
+	if (++ReactorPauseGen == 0)
+	{
+		ReactorPauseGen = 1;
+	}
+	__atomic_store_n(&ReactorPauseRequest, ReactorPauseGen, __ATOMIC_RELEASE);
+
+	while (!__atomic_load_n(&ReactorStopped, __ATOMIC_ACQUIRE) &&
+		   __atomic_load_n(&ReactorPauseAck, __ATOMIC_ACQUIRE) != ReactorPauseGen)
+	{
+		usleep(REACTOR_PAUSE_POLL_US);
+	}
+}
+
+void ReactorResume(void)
+{
+	if (ReactorPauseDepth > 0 && --ReactorPauseDepth == 0)
+	{
+		__atomic_store_n(&ReactorPauseRequest, 0, __ATOMIC_RELEASE);
+	}
 }
 
 
@@ -137,30 +250,50 @@ int main(void)
 
 
     NYCE_STATUS retVal;
+    HOST_STATE host;
+    unsigned int sysRequestSeen = 0;
+    char state;
+    uint64_t initStart;
 
 	initLogFile();
 
+	if (HostEventInit() != 0)
+	{
+		logging(100,0,"eventfd failed, polling sys_case","main");  ////////////////log
+	}
+
+	//node table and per-axis state, sized before any thread touches an axis
+	NodeInit();
+	retVal = AxisRegistryInit(NodeCount * AXIS_LEGACY_COUNT);
+	if (NyceError(retVal))
+	{
+		printf("AxisRegistryInit Error %s\n", NyceGetStatusString(retVal));
+		return 0;
+	}
+	TuneLoad();
+
 	 //initialize dyad
 	dyad_Stream *s;
 	dyad_init();
+	TelemInit();
 
 	s = dyad_newStream();
 	dyad_addListener(s, DYAD_EVENT_ERROR, onError, NULL);
 	dyad_addListener(s, DYAD_EVENT_ACCEPT, onAccept, NULL);
 	dyad_listen(s, 6666);
+	if (ModbusListen(MODBUS_PORT) != 0)
+	{
+		logging(100,(float)MODBUS_PORT,"Modbus listen failed, running without Modbus","main");  ////////////////log
+	}
 	//dyad_setUpdateTimeout(0);
-	pthread_create(&updateThread,0,updateThreadFunc,0);
+	ReactorStopped = 0;
+	if (pthread_create(&updateThread,0,updateThreadFunc,0) != 0)
+	{
+		ReactorStopped = 1;
+	}
 	logging(100,0,"Start ETH server","success");  ////////////////log
 
 
-	 //init buffer mutex
-    if (pthread_mutex_init(&lock, NULL) != 0)
-    {
-        printf("\n mutex init failed\n");
-        return 1;
-    }
-    logging(100,(float)0,"Init mutex","success"); ///// log
-
     //connect to NYCE
     retVal = NyceInit(NYCE_ETH);
     if (NyceError(retVal))
@@ -180,25 +313,50 @@ int main(void)
     logging(100,0,"Wait for sys synchrounous",NyceGetStatusString(retVal)); ///// log
 
 
-    retVal = NhiConnect("localhost", &nodeId);
+    retVal = NodeConnectAll();
     if (NyceError(retVal))
     {
        printf("NhiConnect Error %s\n", NyceGetStatusString(retVal));
        return 0;
     }
-    logging(100,0,"Nhi connect",NyceGetStatusString(retVal));  ////////////////log
+    logging(100,NodeCount,"Nhi connect",NyceGetStatusString(retVal));  ////////////////log
+
+    //trace ring must exist before the UDSX starts
+    retVal = TraceInit();
+    if (NyceError(retVal))
+    {
+       printf("TraceInit Error %s\n", NyceGetStatusString(retVal));
+    }
+    logging(100,0,"Trace ring",NyceGetStatusString(retVal));  ////////////////log
 
 
     //End previous udsx
     EndForceUDSX();
 
+    //axes are driven from the control thread from here on
+    retVal = ControlStart();
+    if (NyceError(retVal))
+    {
+       printf("ControlStart Error %s\n", NyceGetStatusString(retVal));
+       return 0;
+    }
+    logging(100,CONTROL_PERIOD_US,"Control thread",NyceGetStatusString(retVal));  ////////////////log
+
 	//signal handler
     (void)signal(SIGINT, IntHandler);
 
     printf("Press Ctrl-C to stop\n");
     while (!g_stop)
     {
+		//consistent copy of what the update thread decoded, without locking it out
+		HostRead(&host);
+		if (host.sysRequestCount != sysRequestSeen)
+		{
+			sysRequestSeen = host.sysRequestCount;
+			sys_case = host.sysRequest;
+		}
 
+		state = sys_case;
 		switch(sys_case)
 		{
 			case SYS_IDLE:
@@ -207,13 +365,14 @@ int main(void)
 				puts("init");
 				logging(123,sys_case,"Initialising","status"); ///// log
 				//init all axis
+				initStart = MonotonicNs();
 				AxisInit();
-				CTR_FLG[19] = 255;	//Terminate sequence flag
+				HostSetCtr(19, 255);	//Terminate sequence flag
 				sys_case = SYS_READY;
-				logging(123,sys_case,"system ready","status"); ///// log
+				logging(123,(float)(MonotonicSince(initStart) / 1000000.0),"system ready, init ms","status"); ///// log
 				break;
 			case SYS_READY:
-				if(CTR_FLG[19] != 255)
+				if(host.CTR_FLG[19] != 255)
 				{
 					sys_case = SYS_STOP;
 				}
@@ -221,31 +380,50 @@ int main(void)
 			case SYS_STOP:
 				logging(123,sys_case,"system stop","status"); ///// log
 				puts("stop");
-				CTR_FLG[19] = 0;
-				NyceDisconnectAxis();
-				EndForceUDSX();
+				HostSetCtr(19, 0);
+				if (WARM_RESTART)
+				{
+					//the next init only touches what changed in the axis setting
+					HostClearCommands();
+					ControlClearCommands();
+					PathClearAll();
+					TuneClearAll();
+					ArmClearAll();
+					SeqClearAll();
+				}
+				else
+				{
+					NyceDisconnectAxis();
+					EndForceUDSX();
+				}
 				sys_case = SYS_IDLE;
 				break;
 
 		}
 
-		usleep(1000);
+		ControlReport();
+		TuneReport();
+
+		//a transition is followed right away, otherwise sleep until the reactor, control thread or a signal posts
+		if (sys_case == state)
+		{
+			HostWaitEvent();
+		}
     }
 
+      ControlStop();
+      logging(100,1,"control thread stopped","success");  ////////////////log
+
 
       NyceDisconnectAxis();
       logging(100,1,"disconnect axis","success");  ////////////////log
 
 
       EndForceUDSX();
+      TraceTerm();
 
-      retVal = NhiDisconnect(nodeId);
-      if ( NyceError(retVal) )
-      {
-
-           printf("NhiDisconnect Error %s\n", NyceGetStatusString(retVal));
-      }
-      logging(100,1,"Nhi disconnected",NyceGetStatusString(retVal));  ////////////////log
+      NodeDisconnectAll();
+      logging(100,NodeCount,"Nhi disconnected","success");  ////////////////log
 
 
       retVal = NyceTerm();
@@ -255,9 +433,6 @@ int main(void)
       }
       logging(100,1,"nyce terminated",NyceGetStatusString(retVal));  ////////////////log
 
-      //disable mutex
-      pthread_mutex_destroy(&lock);
-
 
       ////shutdown DYAD
       dyad_shutdown();
@@ -270,575 +445,635 @@ int main(void)
       return 0;
 }
 
-void AxisInit(void)
+/**
+ * @brief   One SacConnect running on its own thread.
+ */
+typedef struct axis_connect
 {
-	int ax,retVal;
-	AXIS_SETTING axisSetting;
+	pthread_t			thread;
+	int					ax;
+	int					started;		/**< thread created and not joined yet */
+	long				elapsed_ns;
+} AXIS_CONNECT;
 
-	puts("NyceInit");
+static void* AxisConnectFunc(void *arg)
+{
+	AXIS_CONNECT *conn = arg;
+	uint64_t start = MonotonicNs();
 
-	//-------------------------
-	//		Axis Naming
-	//-------------------------
-    for ( ax = 0; ax < 10; ax++ )
-    {
-		strcpy(Axis_Name[ax],"NA");
+	StatusSConnect[conn->ax] = SacConnect(Axis_Name[conn->ax], &sacAxis[conn->ax]);
+	conn->elapsed_ns = MonotonicSince(start);
+	return NULL;
+}
+
+/**
+ *  @brief  Connect every configured axis.
+ *
+ *  A handle still connected with the same name and type is kept. The other axes are connected
+ *  concurrently, one thread each and at most AXIS_CONNECT_THREADS at a time, so the init takes about as
+ *  long as the slowest axis instead of the sum.
+ */
+static void AxisConnectAll(void)
+{
+	AXIS_CONNECT conn[AXIS_MAX];
+	uint64_t start = MonotonicNs();
+	pthread_attr_t attr;
+	int ax, pending = 0, running = 0, oldest = 0;
+
+	memset(conn, 0, sizeof(conn));
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, AXIS_CONNECT_STACK_SIZE);
+
+	for (ax = 0; ax < AxisCount; ax++)
+	{
+		conn[ax].ax = -1;
+
+		if (SacConnected[ax] == 255)
+		{
+			if (Axis_Type[ax] != NA && Axis_Type[ax] == ConnectedType[ax] && strcmp(Axis_Name[ax], ConnectedName[ax]) == 0)
+			{
+				logging(ax,0,"SacConnect reused",Axis_Name[ax]);  ////////////////log
+				continue;
+			}
+
+			//configuration changed, drop the old handle
+			SacConnected[ax] = 0;
+			StatusSDisconnect[ax] = SacDisconnect(sacAxis[ax]);
+			logging(ax,(float)StatusSDisconnect[ax],"SacDisconnect","axis config changed");  ////////////////log
+		}
+
+		if (Axis_Type[ax] == NA)
+		{
+			continue;
+		}
+
+		//wait for the oldest connect before starting one more
+		while (running >= AXIS_CONNECT_THREADS)
+		{
+			if (conn[oldest].started)
+			{
+				pthread_join(conn[oldest].thread, NULL);
+				conn[oldest].started = 0;
+				running--;
+			}
+			oldest++;
+		}
+
+		conn[ax].ax = ax;
+		conn[ax].started = (pthread_create(&conn[ax].thread, &attr, AxisConnectFunc, &conn[ax]) == 0);
+		if (!conn[ax].started)
+		{
+			AxisConnectFunc(&conn[ax]);
+		}
+		running += conn[ax].started;
+		pending++;
 	}
 
-	strcpy(TempName0,AXS_NAM0);
-	strcpy(axisSetting.Shared_AxisName0,TempName0);
-	strcpy(Axis_Name[0],axisSetting.Shared_AxisName0);
+	pthread_attr_destroy(&attr);
 
-	strcpy(TempName1,AXS_NAM1);
-	strcpy(axisSetting.Shared_AxisName1,TempName1);
-	strcpy(Axis_Name[1],axisSetting.Shared_AxisName1);
+	for (ax = 0; ax < AxisCount; ax++)
+	{
+		if (conn[ax].ax < 0)
+		{
+			continue;
+		}
 
-	strcpy(TempName2,AXS_NAM2);
-	strcpy(axisSetting.Shared_AxisName2,TempName2);
-	strcpy(Axis_Name[2],axisSetting.Shared_AxisName2);
+		if (conn[ax].started)
+		{
+			pthread_join(conn[ax].thread, NULL);
+			conn[ax].started = 0;
+		}
 
-	strcpy(TempName3,AXS_NAM3);
-	strcpy(axisSetting.Shared_AxisName3,TempName3);
-	strcpy(Axis_Name[3],axisSetting.Shared_AxisName3);
+		if (StatusSConnect[ax] == 0)
+		{
+			SacConnected[ax] = 255;
+			strcpy(ConnectedName[ax], Axis_Name[ax]);
+			ConnectedType[ax] = Axis_Type[ax];
+		}
+		logging(ax,(float)(conn[ax].elapsed_ns / 1000000.0),"From 144 : SacConnect ms",NyceGetStatusString(StatusSConnect[ax]));  ////////////////log
+	}
 
-	strcpy(TempName4,AXS_NAM4);
-	strcpy(axisSetting.Shared_AxisName4,TempName4);
-	strcpy(Axis_Name[4],axisSetting.Shared_AxisName4);
+	logging(144,(float)(MonotonicSince(start) / 1000000.0),"SacConnect all ms",pending ? "connected" : "nothing to connect");  ////////////////log
+}
 
-	strcpy(TempName5,AXS_NAM5);
-	strcpy(axisSetting.Shared_AxisName5,TempName5);
-	strcpy(Axis_Name[5],axisSetting.Shared_AxisName5);
+void AxisInit(void)
+{
+	int ax, n, i;
+	AXIS_SETTING axisSetting[NODE_MAX];
+	HOST_STATE host;
+	char *settingName[AXIS_LEGACY_COUNT] = AXIS_NAME_TABLE(&axisSetting[0]);
+
+	puts("NyceInit");
 
-	strcpy(TempName6,AXS_NAM6);
-	strcpy(axisSetting.Shared_AxisName6,TempName6);
-	strcpy(Axis_Name[6],axisSetting.Shared_AxisName6);
+	//the handler table, the SAC handles and the parameters are rebuilt below, CTR_FLG[19] is written by the
+	//host and cannot keep the control thread out
+	ControlPause();
 
-	strcpy(TempName7,AXS_NAM7);
-	strcpy(axisSetting.Shared_AxisName7,TempName7);
-	strcpy(Axis_Name[7],axisSetting.Shared_AxisName7);
+	HostRead(&host);
 
-	strcpy(TempName8,AXS_NAM8);
-	strcpy(axisSetting.Shared_AxisName8,TempName8);
-	strcpy(Axis_Name[8],axisSetting.Shared_AxisName8);
+	//-------------------------
+	//		Axis Naming
+	//-------------------------
+    for ( ax = 0; ax < AxisCount; ax++ )
+    {
+		strcpy(Axis_Name[ax],"NA");
+	}
 
-	strcpy(TempName9,AXS_NAM9);
-	strcpy(axisSetting.Shared_AxisName9,TempName9);
-	strcpy(Axis_Name[9],axisSetting.Shared_AxisName9);
+	memset(axisSetting, 0, sizeof(axisSetting));
+	for (ax = 0; ax < AXIS_LEGACY_COUNT && ax < AxisCount; ax++)
+	{
+		strncpy(settingName[ax], host.AXS_NAM[ax], AXIS_NAME_LEN - 1);
+		strcpy(Axis_Name[ax], settingName[ax]);
+	}
 
 // 	-------------------------
 // 			Axis Type
 // 	-------------------------
-    for ( ax = 0; ax < 10; ax++ )
+    for ( ax = 0; ax < AxisCount; ax++ )
     {
 		Axis_Type[ax] = NA;
 	}
 
- 	for (ax = 0 ; ax < 10 ; ax++)
+ 	for (ax = 0 ; ax < AXIS_LEGACY_COUNT && ax < AxisCount ; ax++)
  	{
-		TempAxType = AXS_TYPE[ax];
-		Axis_Type[ax] = TempAxType;
-		axisSetting.Shared_AxisType[ax] = Axis_Type[ax];
+		Axis_Type[ax] = host.AXS_TYPE[ax];
+		axisSetting[0].Shared_AxisType[ax] = Axis_Type[ax];
  	}
 
-	//FORCE_THRESHOLD = 3000;
-	//DP_THRESHOLD = 150;
-	//LINEAR_THRESHOLD = 800;
-
+	//axes above the legacy ones are named with E_AXIS_DEF, each block of them is the setting of the next node
+ 	for (ax = AXIS_LEGACY_COUNT ; ax < AxisCount ; ax++)
+ 	{
+		AxisDefinition(ax, Axis_Name[ax], &Axis_Type[ax]);
+ 	}
 
+ 	for (n = 1; n < NodeCount; n++)
+ 	{
+ 		char *nodeName[AXIS_LEGACY_COUNT] = AXIS_NAME_TABLE(&axisSetting[n]);
+
+ 		for (i = 0; i < AXIS_LEGACY_COUNT; i++)
+ 		{
+ 			ax = n * AXIS_LEGACY_COUNT + i;
+ 			axisSetting[n].Shared_AxisType[i] = (ax < AxisCount) ? Axis_Type[ax] : NA;
+ 			strcpy(nodeName[i], (ax < AxisCount) ? Axis_Name[ax] : "NA");
+ 		}
+ 	}
 
- 	 if (NyceSuccess(NhiUdsxStart(nodeId, "/home/user/librushUDSX.so" , &axisSetting, (uint32_t)sizeof(axisSetting))))
- 	 {
- 		 	 	 	printf("UDSX started successfully.\n");
- 		 	 	 	logging(144,1,"UDSX started","/home/user/librushUDSX.so");  ////////////////log
- 	 }
+ 	AxisBuildHandlers();
 
+	//FORCE_THRESHOLD = 3000;
+	//DP_THRESHOLD = 150;
+	//LINEAR_THRESHOLD = 800;
 
 
- 	//Initialize the shared memory.
- 	retVal = Initialize(FALSE);
- 	if ( NyceError(retVal) )
- 	   {
- 		printf("Initialize Error %s\n", NyceGetStatusString(retVal));
- 		logging(144,1,"initialise shared memory failed",NyceGetStatusString(retVal));  ////////////////log
- 	   }
- 	else
- 	{
- 		logging(144,1,"shared memory started",NyceGetStatusString(retVal));  ////////////////log
- 	 	 if(pShmem_data){
-	 	 	printf("axis name %s ",(char*)&pShmem_data->Shared_AxisName0);
-			printf("axis type %d \n",pShmem_data->Shared_AxisType[0]);
-			printf("axis name %s ",(char*)&pShmem_data->Shared_AxisName1);
-			printf("axis type %d \n",pShmem_data->Shared_AxisType[1]);
-			printf("axis name %s ",(char*)&pShmem_data->Shared_AxisName2);
-			printf("axis type %d \n",pShmem_data->Shared_AxisType[2]);
-			printf("axis name %s ",(char*)&pShmem_data->Shared_AxisName3);
-			printf("axis type %d \n",pShmem_data->Shared_AxisType[3]);
-			printf("axis name %s ",(char*)&pShmem_data->Shared_AxisName4);
-			printf("axis type %d \n",pShmem_data->Shared_AxisType[4]);
-			printf("axis name %s ",(char*)&pShmem_data->Shared_AxisName5);
-			printf("axis type %d \n",pShmem_data->Shared_AxisType[5]);
-			printf("axis name %s ",(char*)&pShmem_data->Shared_AxisName6);
-			printf("axis type %d \n",pShmem_data->Shared_AxisType[6]);
-			printf("axis name %s ",(char*)&pShmem_data->Shared_AxisName7);
-			printf("axis type %d \n",pShmem_data->Shared_AxisType[7]);
-			printf("axis name %s ",(char*)&pShmem_data->Shared_AxisName8);
-			printf("axis type %d \n",pShmem_data->Shared_AxisType[8]);
-			printf("axis name %s ",(char*)&pShmem_data->Shared_AxisName9);
-			printf("axis type %d \n",pShmem_data->Shared_AxisType[9]);
- 	 	 }
- 	}
 
+	//warm restart: a node keeps its UDSX and shared memory when the setting of its axes is unchanged
+	NodeApplySettings(axisSetting);
 
+    AxisConnectAll();
 
-    for ( ax = 0; ax < 10; ax++ )
-    {
-		if (Axis_Type[ax] != NA)
-		{
-			StatusSConnect[ax] = SacConnect(Axis_Name[ax], &sacAxis[ax]);
-
-			if (StatusSConnect[ax] == 0)
-			{
-				SacConnected[ax] = 255;
-				logging(ax,(float)SacConnected[ax],"From 144 : SacConnect","sac Connected");  ////////////////log
-			}
-		}
+	for ( ax = 0; ax < AxisCount; ax++ )
+	{
+		SacMovedCnt[ax] = 0;
+		Cmd_Toggle[ax] = 0;
+		*AxisStatFlag(ax) = 0x01;
+		AxisResetParams(ax, Axis_Type[ax]);
+		TuneApplySaved(ax);
 	}
 
     if (pShmem_data)
     {
 
-		for ( ax = 0; ax < 10; ax++ )
+		for ( ax = 0; ax < AXIS_LEGACY_COUNT && ax < AxisCount; ax++ )
 		{
-			SacMovedCnt[ax] = 0;
-			CMD_FLG[ax] = Cmd_Toggle[ax] = 0;
-			pShmem_data->Shared_StatFlag[ax] = 0x01;
-			pShmem_data->Shared_CtrFlag[ax] = CTR_FLG[ax] = 0;
-			pShmem_data->Shared_CtrFlag[ax + 10] = CTR_FLG[ax + 10] = 0;
-
-			if (Axis_Type[ax] == TURRET)
-			{
-				pShmem_data->Shared_CtrFlag[ax + 20] = CTR_FLG[ax + 20] = 10;
-				pShmem_data->Shared_CtrFlag[ax + 30] = CTR_FLG[ax + 30] = 1;
-			}
-			else
-			{
-				pShmem_data->Shared_CtrFlag[ax + 20] = CTR_FLG[ax + 20] = 1000;
-				pShmem_data->Shared_CtrFlag[ax + 30] = CTR_FLG[ax + 30] = 1;
-			}
-
+			pShmem_data->Shared_CtrFlag[ax + 10] = HostSetCtr(ax + 10, 0);
 		}
+		AxisParamsToCtr(0, pShmem_data->Shared_CtrFlag);
+		HostClearCommands();
+		ControlClearCommands();
+		PathClearAll();
+		TuneClearAll();
+		ArmClearAll();
+		SeqClearAll();
     }
 
-	CTR_FLG[10] = 4.5;	//speed factor
-	CTR_FLG[11] = 150;	//DP sensitivity
-	CTR_FLG[12] = 800;	//Linear up threshold
-	CTR_FLG[13] = 1000;	//Rest position
-	CTR_FLG[14] = 3000;	//Force control threshold
-	CTR_FLG[15] = 10;	//ScanForceRate
-	CTR_FLG[16] = 0;	//Tweak table bypass
-	CTR_FLG[17] = 0;	//VC Open loop ramp
-	CTR_FLG[18] = 0;	//VC Open loop value
+	HostSetCtr(10, 4.5);	//speed factor
+	HostSetCtr(11, 150);	//DP sensitivity
+	HostSetCtr(12, 800);	//Linear up threshold
+	HostSetCtr(13, 1000);	//Rest position
+	HostSetCtr(14, 3000);	//Force control threshold
+	HostSetCtr(15, 10);	//ScanForceRate
+	HostSetCtr(16, 0);	//Tweak table bypass
+	HostSetCtr(17, 0);	//VC Open loop ramp
+	HostSetCtr(18, 0);	//VC Open loop value
 	//CTR_FLG[19] = 255;	//Terminate sequence flag
 
-	CTR_FLG[40] = 250;	//VC soft landing default distance[AxisID]
-	CTR_FLG[41] = 0.005;//VC soft landing default duration
+	HostSetCtr(40, 250);	//VC soft landing default distance[AxisID]
+	HostSetCtr(41, 0.005);//VC soft landing default duration
 
+	ControlResume();
 
 }
 
-void NyceMainLoop(void)
+/*
+ * Axis command handlers, selected per axis from Axis_Type by AxisBuildHandlers.
+ */
+static void CmdTurretMove(const AXIS_CMD *cmd)
 {
+	int ax = cmd->axis;
 
-	int ax;
-    int CmdType;
-
-	if(CTR_FLG[19] == 255)
+	if (AxisParam[AXIS_PAR_ABSOLUTE][ax] == 0)
+	{
+		m_sacPtpPars[ax].positionReference = SAC_RELATIVE;
+	}
+	else
 	{
+		m_sacPtpPars[ax].positionReference = SAC_ABSOLUTE;
+	}
+	logging(ax,(float)*AxisStatFlag(ax),"default","turret");  ////////////////log
+	ProfileExecute(cmd);
+}
 
-		SPEED_FACTOR = CTR_FLG[10];
+static void CmdTurretOpenLoop(const AXIS_CMD *cmd)
+{
+	int ax = cmd->axis;
 
-		for ( ax = 0; ax < 10; ax++)
-		{
-			STANDBY_POS[ax] = CTR_FLG[ax+60];
-		}
+	logging(ax,(float)*AxisStatFlag(ax),"open loop","turret");  ////////////////log
+	StatusOpenLoop[ax] = SacOpenLoop(sacAxis[ax]);
+	*AxisStatFlag(ax) = 0x01;
+}
 
-		for ( ax = 0; ax < 10; ax++)
-		{
-			if (SacConnected[ax] == 255)
-			{
+static void CmdTurretLock(const AXIS_CMD *cmd)
+{
+	int ax = cmd->axis;
 
+	logging(ax,(float)*AxisStatFlag(ax),"open loop","turret");  ////////////////log
+	StatusLock[ax] = SacLock(sacAxis[ax]);
+	*AxisStatFlag(ax) = 0x01;
+}
 
-				if (CMD_FLG[ax] != 0)
-				{
-					logging(ax,CMD_FLG[ax],"CMD_FLG"," NyceMainLoop");  ////////////////log
-					oldCmdPos[ax] = CMD_FLG[ax];
-					switch(Axis_Type[ax])
-					{
-						case TURRET:
-							if (CTR_FLG[50 + ax] == 0)
-							{
-								m_sacPtpPars[ax].positionReference = SAC_RELATIVE;
-							}
-							else
-							{
-								m_sacPtpPars[ax].positionReference = SAC_ABSOLUTE;
-							}
-
-							CmdType = CMD_FLG[ax]/10000;
-							switch(CmdType)
-							{
-								default:
-									logging(ax,(float)pShmem_data->Shared_StatFlag[ax],"default","turret");  ////////////////log
-									ExeParabolicProfile(ax);
-									break;
-
-								case OpenLoop:
-									logging(ax,(float)pShmem_data->Shared_StatFlag[ax],"open loop","turret");  ////////////////log
-									StatusOpenLoop[ax] = SacOpenLoop(sacAxis[ax]);
-									pShmem_data->Shared_StatFlag[ax] = 0x01;
-						 			break;
-
-								case AxisLock:
-									logging(ax,(float)pShmem_data->Shared_StatFlag[ax],"open loop","turret");  ////////////////log
-									StatusLock[ax] = SacLock(sacAxis[ax]);
-									pShmem_data->Shared_StatFlag[ax] = 0x01;
-									break;
-							}
-							break;
-
-						case VC_PUSHER:
-							m_sacPtpPars[ax].positionReference = SAC_ABSOLUTE;
-							CmdType = CMD_FLG[ax]/10000;
-			 				switch(CmdType)
-							{
-								default:
-									logging(ax,(float)pShmem_data->Shared_StatFlag[ax],"default","pusher");  ////////////////log
-									ExeParabolicProfile(ax);
-									break;
-
-								case ChgWorkPos:
-									logging(ax,(float)pShmem_data->Shared_StatFlag[ax],"change work position","pusher");  ////////////////log
-									CMD_FLG[ax] = CMD_FLG[ax] - ChgWorkPos*10000;
-									CTR_FLG[ax] = CMD_FLG[ax];
-
-			 						ExeParabolicProfile(ax);
-									break;
-
-								case OpenLoop:
-									logging(ax,(float)pShmem_data->Shared_StatFlag[ax],"open loop","pusher");  ////////////////log
-									StatusWParameter[ax] = SacWriteParameter(sacAxis[ax],SAC_PAR_OPEN_LOOP_RAMP,CTR_FLG[17]);
-                                    StatusWParameter[ax] = SacWriteParameter(sacAxis[ax],SAC_PAR_OPEN_LOOP_VALUE,CTR_FLG[18]);
-                                    StatusOpenLoop[ax] = SacOpenLoop(sacAxis[ax]);
-									pShmem_data->Shared_StatFlag[ax] = 0x01;
-									break;
-
-								case AxisLock:
-									puts("axis lock");
-									logging(ax,(float)pShmem_data->Shared_StatFlag[ax],"lock","pusher");  ////////////////log
-									StatusWParameter[ax] = SacWriteParameter(sacAxis[ax],SAC_PAR_OPEN_LOOP_RAMP,CTR_FLG[17]);
-                                    StatusWParameter[ax] = SacWriteParameter(sacAxis[ax],SAC_PAR_OPEN_LOOP_VALUE,0);
-                                    StatusLock[ax] = SacLock(sacAxis[ax]);
-									pShmem_data->Shared_StatFlag[ax] = 0x01;
-									break;
-							}
-
-							break;
-
-						case STD_ABS:
-							logging(ax,pShmem_data->Shared_StatFlag[ax],"STD_ABS","STD");  ////////////////log
-							m_sacPtpPars[ax] .positionReference = SAC_ABSOLUTE;
-							ExeParabolicProfile(ax);
-							break;
-
-						case STD_REL:
-							logging(ax,pShmem_data->Shared_StatFlag[ax],"STD_REL","STD");  ////////////////log
-							m_sacPtpPars[ax] .positionReference = SAC_RELATIVE;
-							ExeParabolicProfile(ax);
-							break;
-					}
+static void CmdPusherMove(const AXIS_CMD *cmd)
+{
+	int ax = cmd->axis;
 
-					if (Cmd_Toggle[ax] == 0)
-					{
-						Cmd_Toggle[ax] = 1;
-					}
-					else
-					{
-						Cmd_Toggle[ax] = 0;
-					}
+	m_sacPtpPars[ax].positionReference = SAC_ABSOLUTE;
+	logging(ax,(float)*AxisStatFlag(ax),"default","pusher");  ////////////////log
+	ProfileExecute(cmd);
+}
 
-					pShmem_data->Shared_StatFlag[ax] |= Cmd_Toggle[ax]*0x80;
+static void CmdPusherChgWorkPos(const AXIS_CMD *cmd)
+{
+	int ax = cmd->axis;
 
-					oldPtpPos[ax] = CMD_FLG[ax];
-					CMD_FLG[ax] = 0;
+	m_sacPtpPars[ax].positionReference = SAC_ABSOLUTE;
+	logging(ax,(float)*AxisStatFlag(ax),"change work position","pusher");  ////////////////log
+	AxisSetParam(ax, AXIS_PAR_WORK_POS, cmd->position);
+	if (ax < AXIS_LEGACY_COUNT)
+	{
+		CTR_FLG[ax] = cmd->position;	//Shared_CtrFlag takes it over in this cycle, with the move
+	}
+	ProfileExecute(cmd);
+}
 
-					SacMovedCnt[ax]++;
-				}
-			}
+static void CmdPusherOpenLoop(const AXIS_CMD *cmd)
+{
+	int ax = cmd->axis;
 
-			if(pShmem_data){
-				pShmem_data->Shared_CtrFlag[ax] = CTR_FLG[ax];
-				pShmem_data->Shared_CtrFlag[ax + 10] = CTR_FLG[ax + 10];
-				pShmem_data->Shared_CtrFlag[ax + 50] = CTR_FLG[ax + 50];
-				pShmem_data->Shared_CtrFlag[ax + 60] = CTR_FLG[ax + 60];
-			}
-		}
+	logging(ax,(float)*AxisStatFlag(ax),"open loop","pusher");  ////////////////log
+	StatusWParameter[ax] = SacWriteParameter(sacAxis[ax],SAC_PAR_OPEN_LOOP_RAMP,CTR_FLG[17]);
+	StatusWParameter[ax] = SacWriteParameter(sacAxis[ax],SAC_PAR_OPEN_LOOP_VALUE,CTR_FLG[18]);
+	StatusOpenLoop[ax] = SacOpenLoop(sacAxis[ax]);
+	*AxisStatFlag(ax) = 0x01;
+}
 
-		//waitforUDSX(1);//(resp_cmd);
-	}
+static void CmdPusherLock(const AXIS_CMD *cmd)
+{
+	int ax = cmd->axis;
+
+	logging(ax,(float)*AxisStatFlag(ax),"lock","pusher");  ////////////////log
+	StatusWParameter[ax] = SacWriteParameter(sacAxis[ax],SAC_PAR_OPEN_LOOP_RAMP,CTR_FLG[17]);
+	StatusWParameter[ax] = SacWriteParameter(sacAxis[ax],SAC_PAR_OPEN_LOOP_VALUE,0);
+	StatusLock[ax] = SacLock(sacAxis[ax]);
+	*AxisStatFlag(ax) = 0x01;
 }
 
-int NyceDisconnectAxis(void)
+static void CmdStdAbsMove(const AXIS_CMD *cmd)
 {
-	int ax;
-	   for ( ax = 0; ax < 10; ax++ )
-	    {
-			if (SacConnected[ax] == 255)
-			{
-				StatusSDisconnect[ax] = SacDisconnect(sacAxis[ax]);
-				logging(ax,(float)StatusSDisconnect[ax],"SacDisconnect","nyce disconnect axis");  ////////////////log
-			}
-	    }
-	return 0;
+	int ax = cmd->axis;
+
+	logging(ax,*AxisStatFlag(ax),"STD_ABS","STD");  ////////////////log
+	m_sacPtpPars[ax].positionReference = SAC_ABSOLUTE;
+	ProfileExecute(cmd);
 }
 
+static void CmdStdRelMove(const AXIS_CMD *cmd)
+{
+	int ax = cmd->axis;
+
+	logging(ax,*AxisStatFlag(ax),"STD_REL","STD");  ////////////////log
+	m_sacPtpPars[ax].positionReference = SAC_RELATIVE;
+	ProfileExecute(cmd);
+}
 
-void ExeMinJerkProfile(int AxisID)
+/**
+ *  @brief  Fill AxisHandler from Axis_Type. An opcode without handler is not supported by the axis.
+ */
+void AxisBuildHandlers(void)
 {
-	if (m_sacPtpPars[AxisID].positionReference == SAC_ABSOLUTE)
-	{
-		distance[AxisID] = CMD_FLG[AxisID] - pShmem_data->Shared_SetPointPos[AxisID];
-	}
-	else
-	{
-		distance[AxisID] = CMD_FLG[AxisID];
-	}
+	int ax;
 
-	ratio[AxisID] = abs(distance[AxisID])/CTR_FLG[20 + AxisID];			//CMD_FLG[20 + ax] defines the default distance of an axis
-	duration[AxisID] = CTR_FLG[30 + AxisID] * ratio[AxisID];			//CMD_FLG[30 + ax] defines the default duration of an axis
+	memset(AxisHandler, 0, AxisCount * sizeof(*AxisHandler));
 
-	if (duration[AxisID] < CTR_FLG[30 + AxisID])
+	for (ax = 0; ax < AxisCount; ax++)
 	{
-		duration[AxisID] = CTR_FLG[30 + AxisID];
+		switch (Axis_Type[ax])
+		{
+			case TURRET:
+				AxisHandler[ax][OP_MOVE]		= CmdTurretMove;
+				AxisHandler[ax][OP_OPEN_LOOP]	= CmdTurretOpenLoop;
+				AxisHandler[ax][OP_LOCK]		= CmdTurretLock;
+				break;
+
+			case VC_PUSHER:
+				AxisHandler[ax][OP_MOVE]		= CmdPusherMove;
+				AxisHandler[ax][OP_CHG_WORK_POS]= CmdPusherChgWorkPos;
+				AxisHandler[ax][OP_OPEN_LOOP]	= CmdPusherOpenLoop;
+				AxisHandler[ax][OP_LOCK]		= CmdPusherLock;
+				break;
+
+			case STD_ABS:
+				AxisHandler[ax][OP_MOVE]		= CmdStdAbsMove;
+				break;
+
+			case STD_REL:
+				AxisHandler[ax][OP_MOVE]		= CmdStdRelMove;
+				break;
+		}
 	}
+}
 
-	m_sacPtpPars[AxisID].velocity		=  2 * abs(distance[AxisID]) / duration[AxisID];
-	m_sacPtpPars[AxisID].acceleration	=  4 * m_sacPtpPars[AxisID].velocity / duration[AxisID];
-	m_sacPtpPars[AxisID].jerk			=  4 * m_sacPtpPars[AxisID].acceleration / duration[AxisID];
-	m_sacPtpPars[AxisID].position		=  (double)CMD_FLG[AxisID];
+/**
+ *  @brief  Compatibility shim for the float encoded CMD_FLG.
+ *
+ *  CMD_FLG[ax]/10000 selects ChgWorkPos, OpenLoop or AxisLock when the axis type supports it,
+ *  any other value is a move to CMD_FLG[ax] itself.
+ */
+static void AxisCmdFromLegacy(int ax, float value, AXIS_CMD *cmd)
+{
+	int CmdType = value/10000;
 
-	if (m_sacPtpPars[AxisID].velocity == 0)
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->axis = ax;
+	cmd->opcode = OP_MOVE;
+	cmd->position = value;
+
+	switch (CmdType)
 	{
-		m_sacPtpPars[AxisID].velocity = 10;
+		case ChgWorkPos:
+			if (AxisHandler[ax][OP_CHG_WORK_POS])
+			{
+				cmd->opcode = OP_CHG_WORK_POS;
+				cmd->position = value - ChgWorkPos*10000;
+			}
+			break;
+		case OpenLoop:
+			if (AxisHandler[ax][OP_OPEN_LOOP])
+			{
+				cmd->opcode = OP_OPEN_LOOP;
+			}
+			break;
+		case AxisLock:
+			if (AxisHandler[ax][OP_LOCK])
+			{
+				cmd->opcode = OP_LOCK;
+			}
+			break;
 	}
+}
 
-	if (m_sacPtpPars[AxisID].acceleration == 0)
+/**
+ *  @brief  Run one axis command through the handler table and flag it to the host.
+ */
+static void AxisExecute(const AXIS_CMD *cmd)
+{
+	int ax = cmd->axis;
+	AXIS_HANDLER handler;
+
+	//a warm stop leaves the axes connected, they only move while the system is ready
+	if (ax < 0 || ax >= AxisCount || AXIS_CMD_OPCODE(cmd) >= OP_COUNT || SacConnected[ax] != 255 || sys_case != SYS_READY)
 	{
-		m_sacPtpPars[AxisID].acceleration = 10;
+		return;
 	}
 
-	if (m_sacPtpPars[AxisID].jerk == 0)
+	handler = AxisHandler[ax][AXIS_CMD_OPCODE(cmd)];
+	if (handler == NULL)
 	{
-		m_sacPtpPars[AxisID].jerk = 10;
+		logging(ax,(float)AXIS_CMD_OPCODE(cmd),"opcode not supported by axis type","AxisExecute");  ////////////////log
+		return;
 	}
 
-	StatusPtp[AxisID] = SacPointToPoint(sacAxis[AxisID],&m_sacPtpPars[AxisID]);
-
-	pShmem_data->Shared_StatFlag[AxisID] = 0;
+	oldCmdPos[ax] = cmd->position;
+	handler(cmd);
 
-	if (fabs(distance[AxisID]) <= 1)
+	if (Cmd_Toggle[ax] == 0)
 	{
-		pShmem_data->Shared_StatFlag[AxisID] |= 0x01;
+		Cmd_Toggle[ax] = 1;
 	}
+	else
+	{
+		Cmd_Toggle[ax] = 0;
+	}
+
+	*AxisStatFlag(ax) |= Cmd_Toggle[ax]*0x80;
+
+	oldPtpPos[ax] = cmd->position;
+	SacMovedCnt[ax]++;
 }
 
-void ExeEnergyOptimum3rdOrderProfile(int AxisID)
+/**
+ *  @brief  Whether the UDSX completed a cycle since the last moves were written, so new ones can follow.
+ *
+ *  Checked at the start of a control cycle instead of waiting for the UDSX at the end of the previous one.
+ *  Like waitforUDSX it gives up after UDSX_WAIT_TIMEOUT_US.
+ */
+static int UdsxTookOver(void)
 {
-	if (m_sacPtpPars[AxisID].positionReference == SAC_ABSOLUTE)
+	if (!UdsxPending)
 	{
-		distance[AxisID] = CMD_FLG[AxisID] - pShmem_data->Shared_SetPointPos[AxisID];
+		return 1;
 	}
-	else
-	{
-		distance[AxisID] = CMD_FLG[AxisID];
-	}
-
-	ratio[AxisID] = abs(distance[AxisID])/CTR_FLG[20 + AxisID];			//CMD_FLG[20 + ax] defines the default distance of an axis
-	duration[AxisID] = CTR_FLG[30 + AxisID] * ratio[AxisID];			//CMD_FLG[30 + ax] defines the default duration of an axis
 
-	if (duration[AxisID] < CTR_FLG[30 + AxisID])
+	if (!UdsxSyncAvailable() ||
+		__atomic_load_n(&pShmem_data->udsx_cycle, __ATOMIC_ACQUIRE) != UdsxPendingCycle ||
+		MonotonicSince(UdsxPendingSince) >= UDSX_WAIT_TIMEOUT_US * 1000ULL)
 	{
-		duration[AxisID] = CTR_FLG[30 + AxisID];
+		UdsxPending = 0;
+		return 1;
 	}
+	return 0;
+}
 
-	m_sacPtpPars[AxisID].velocity		= 1.5 * abs(distance[AxisID]) / duration[AxisID];
-	m_sacPtpPars[AxisID].acceleration	= 4.5 * m_sacPtpPars[AxisID].velocity / duration[AxisID];
-	m_sacPtpPars[AxisID].jerk			= 9   * m_sacPtpPars[AxisID].acceleration / duration[AxisID];
-	m_sacPtpPars[AxisID].position		=  (double)CMD_FLG[AxisID];
+void NyceMainLoop(void)
+{
 
-	if (m_sacPtpPars[AxisID].velocity == 0)
-	{
-		m_sacPtpPars[AxisID].velocity = 10;
-	}
+	int ax, i, kept;
+	AXIS_MASK batched;
 
-	if (m_sacPtpPars[AxisID].acceleration == 0)
+	//the commands wait in the queue for the next cycle, the control thread never blocks on the UDSX
+	if(CTR_FLG[19] == 255 && UdsxTookOver())
 	{
-		m_sacPtpPars[AxisID].acceleration = 10;
-	}
 
-	if (m_sacPtpPars[AxisID].jerk == 0)
-	{
-		m_sacPtpPars[AxisID].jerk = 10;
-	}
+		//STANDBY_POS and the other per-axis parameters follow CTR_FLG through AxisParamsFromCtr
+		SPEED_FACTOR = CTR_FLG[10];
 
-	StatusPtp[AxisID] = SacPointToPoint(sacAxis[AxisID],&m_sacPtpPars[AxisID]);
+		MoveEventPoll();
+		AxisStatsPoll();
+		ArmPoll();
+		SeqPoll();
+		PathPoll();
+		TunePoll();
+
+		//explicit commands in the order they were received, one per axis and cycle so the moves of
+		//different axes start together; commands for an unconnected axis are dropped
+		kept = 0;
+		batched = 0;
+		PtpBatchBegin();
+		for (i = 0; i < AxisCmdCount; i++)
+		{
+			ax = AxisCmdQueue[i].axis;
+			if (SacConnected[ax] != 255)
+			{
+				//kept back they would fill the queue and starve every other axis
+				logging(ax,(float)AxisCmdQueue[i].opcode,"AXIS_CMD dropped, axis not connected"," NyceMainLoop");  ////////////////log
+			}
+			else if (batched & AXIS_BIT(ax))
+			{
+				AxisCmdQueue[kept++] = AxisCmdQueue[i];
+			}
+			else
+			{
+				logging(ax,(float)AxisCmdQueue[i].opcode,"AXIS_CMD"," NyceMainLoop");  ////////////////log
+				AxisExecute(&AxisCmdQueue[i]);
+				batched |= AXIS_BIT(ax);
+			}
+		}
+		AxisCmdCount = kept;
+		ProfileSyncBatch();
+		PtpBatchIssue();
+		MoveEventIssued();
 
-	pShmem_data->Shared_StatFlag[AxisID] = 0;
+		for ( ax = 0; ax < AXIS_LEGACY_COUNT; ax++)
+		{
+			if(pShmem_data){
+				pShmem_data->Shared_CtrFlag[ax] = CTR_FLG[ax];
+				pShmem_data->Shared_CtrFlag[ax + 10] = CTR_FLG[ax + 10];
+				pShmem_data->Shared_CtrFlag[ax + 50] = CTR_FLG[ax + 50];
+				pShmem_data->Shared_CtrFlag[ax + 60] = CTR_FLG[ax + 60];
+			}
+		}
+		NodeMirrorCtr(CTR_FLG);
 
-	if (fabs(distance[AxisID]) <= 1)
-	{
-		pShmem_data->Shared_StatFlag[AxisID] |= 0x01;
+		//let the UDSX take the new moves and Shared_CtrFlag over before the next cycle writes again
+		if (batched && UdsxSyncAvailable())
+		{
+			UdsxPendingCycle = __atomic_load_n(&pShmem_data->udsx_cycle, __ATOMIC_ACQUIRE);
+			UdsxPendingSince = MonotonicNs();
+			UdsxPending = 1;
+		}
 	}
 }
 
-void ExeParabolicProfile(int AxisID)
+/**
+ *  @brief  Hand the host written CTR_FLG/FORCE_LIMIT and the queued axis commands to the UDSX and the axes.
+ *
+ *  Called by the control thread every CONTROL_PERIOD_US.
+ */
+void NyceApplyCommands(void)
 {
-	if (m_sacPtpPars[AxisID].positionReference == SAC_ABSOLUTE)
-	{
-		distance[AxisID] = CMD_FLG[AxisID] - pShmem_data->Shared_SetPointPos[AxisID];
-	}
-	else
+	if (pShmem_data)
 	{
-		distance[AxisID] = CMD_FLG[AxisID];
+		memcpy(&pShmem_data->FORCE_LIMIT[0], &FORCE_LIMIT[0], sizeof(FORCE_LIMIT));
 	}
 
-	ratio[AxisID] = abs(distance[AxisID])/CTR_FLG[20 + AxisID];			//CMD_FLG[20 + ax] defines the default distance of an axis
-	duration[AxisID] = CTR_FLG[30 + AxisID] * ratio[AxisID];			//CMD_FLG[30 + ax] defines the default duration of an axis
+	NyceMainLoop();
+}
 
-	if (duration[AxisID] < CTR_FLG[30 + AxisID])
-	{
-		duration[AxisID] = CTR_FLG[30 + AxisID];
-	}
+/**
+ *  @brief  Mark host commands as received; they are handed to the control thread at the end of the reactor cycle.
+ */
+void NyceStageCommands(void)
+{
+	CmdStaged = 1;
+}
 
-	m_sacPtpPars[AxisID].velocity		= abs(distance[AxisID]) / (duration[AxisID]/2);
-	m_sacPtpPars[AxisID].acceleration	= m_sacPtpPars[AxisID].velocity / (duration[AxisID]/2);
-	m_sacPtpPars[AxisID].jerk			= -1;												//0 => no value , = infinity
-	m_sacPtpPars[AxisID].position		= (double)CMD_FLG[AxisID];
+/**
+ *  @brief  End of a reactor cycle: hand everything decoded in the cycle to the control thread, then reply.
+ *
+ *  The frames of a burst are folded by the decoders: CTR_FLG and FORCE_LIMIT are latest-wins and published
+ *  once with HostSync, CMD_FLG keeps the latest command of each axis. E_AXIS_CMD commands were queued as
+ *  they were decoded.
+ */
+void NyceEndCycle(void)
+{
+	int ax;
+	AXIS_CMD cmd;
 
-	if (m_sacPtpPars[AxisID].velocity == 0)
+	if (CmdStaged)
 	{
-		m_sacPtpPars[AxisID].velocity = 10;
-	}
+		CmdStaged = 0;
+		HostSync();
 
-	if (m_sacPtpPars[AxisID].acceleration == 0)
-	{
-		m_sacPtpPars[AxisID].acceleration = 10;
+		for (ax = 0; ax < AXIS_LEGACY_COUNT && ax < AxisCount; ax++)
+		{
+			if (CMD_FLG[ax] != 0)
+			{
+				logging(ax,CMD_FLG[ax],"CMD_FLG","NyceEndCycle");  ////////////////log
+				AxisCmdFromLegacy(ax, CMD_FLG[ax], &cmd);
+				if (!ControlPush(&cmd))
+				{
+					//retry next cycle
+					CmdStaged = 1;
+					break;
+				}
+				CMD_FLG[ax] = 0;
+			}
+		}
 	}
 
-	StatusPtp[AxisID] = SacPointToPoint(sacAxis[AxisID],&m_sacPtpPars[AxisID]);
-
-	pShmem_data->Shared_StatFlag[AxisID] = 0;
-
-	if (fabs(distance[AxisID]) <= 1)
-	{
-		pShmem_data->Shared_StatFlag[AxisID] |= 0x01;
-	}
+	TelemFlush();
 }
 
-void EndForceUDSX(void)
+int NyceDisconnectAxis(void)
 {
-	NYCE_STATUS return_stat;
-	Terminate();
-
-    return_stat = NhiUdsxStop(nodeId);
-    logging(1,(float)return_stat,"NhiUdsxStop","EndForceUDSX");  ////////////////log
-
+	int ax;
+	   for ( ax = 0; ax < AxisCount; ax++ )
+	    {
+			if (SacConnected[ax] == 255)
+			{
+				SacConnected[ax] = 0;
+				StatusSDisconnect[ax] = SacDisconnect(sacAxis[ax]);
+				logging(ax,(float)StatusSDisconnect[ax],"SacDisconnect","nyce disconnect axis");  ////////////////log
+			}
+	    }
+	return 0;
 }
 
-static NYCE_STATUS Initialize(BOOL create)
-{
-    NYCE_STATUS retVal = NYCE_OK;
 
-    /*
-     * Create shared memory object.
-     */
-    g_sharedMemoryDescriptor = shm_open(SHM_NAME, O_RDWR | (create ? O_CREAT : 0), S_IRUSR | S_IWUSR);
-    if (g_sharedMemoryDescriptor != -1)
-    {
-        g_created = create;
-
-        /*
-         *  Set its size to the size of the data.
-         */
-        if (!create ||
-            (ftruncate(g_sharedMemoryDescriptor, sizeof(*pShmem_data)) == 0))
-        {
-            /*
-             * Map shared memory object.
-             */
-        	pShmem_data = mmap(NULL, sizeof(*pShmem_data),
-                              PROT_READ | PROT_WRITE, MAP_SHARED,
-                              g_sharedMemoryDescriptor, 0);
-            if (pShmem_data == MAP_FAILED)
-            {
-                retVal = USR_ERR_FAILED_TO_MAP_SHM;
-                pShmem_data = NULL;
-            }
-            else
-            {
-                if (create)
-                {
-                    memset(pShmem_data, 0, sizeof(*pShmem_data));
-                }
-            }
-        }
-        else
-        {
-            retVal = USR_ERR_FAILED_TO_RESIZE_SHM;
-        }
-
-        if (NyceError(retVal))
-        {
-            /*
-             * If an error occurred we must close the descriptor again.
-             */
-            Terminate();
-        }
-    }
-    else
-    {
-        retVal = USR_ERR_FAILED_TO_CREATE_SHM;
-    }
+void EndForceUDSX(void)
+{
+	int n;
 
-    return retVal;
-}
+	//nothing may read the shared memory while it is unmapped
+	ControlPause();
+	ReactorPause();
 
-static void Terminate(void)
-{
-    if (pShmem_data)
-    {
-        /*
-         * If the counter is mapped we must unmap it.
-         */
-        (void)munmap(pShmem_data, sizeof(*pShmem_data));
-        pShmem_data = NULL;
-    }
+	for (n = 0; n < NodeCount; n++)
+	{
+		NodeStopUdsx(&Nodes[n]);
+	}
 
-    if (g_sharedMemoryDescriptor != -1)
-    {
-        /*
-         * When the descriptor is still open we need to close it.
-         */
-        (void)close(g_sharedMemoryDescriptor);
-        g_sharedMemoryDescriptor = -1;
-
-        if (g_created)
-        {
-            /*
-             * Finally, the file that was created must be removed.
-             */
-            (void)shm_unlink(SHM_NAME);
-        }
-    }
+	ReactorResume();
+	ControlResume();
 }
 
 
@@ -907,20 +1142,75 @@ int closeLogFile(void)
 	return 1;
 }
 
+/**
+ *  @brief  Whether the running UDSX posts the udsx_cycle futex.
+ */
+int UdsxSyncAvailable(void)
+{
+	return pShmem_data &&
+		   g_sharedMemorySize >= sizeof(SHMEM_DATA) &&
+		   __atomic_load_n(&pShmem_data->sync_magic, __ATOMIC_ACQUIRE) == SHM_SYNC_MAGIC;
+}
+
+/**
+ *  @brief  Wait until the UDSX completes a cycle, so it has taken over what was written to the shared memory.
+ *
+ *  Sleeps on the udsx_cycle futex when the UDSX posts it. An older UDSX only sets udsx_enter/udsx_exit;
+ *  these are polled every UDSX_POLL_US instead of spinning. Either way the wait ends after UDSX_WAIT_TIMEOUT_US.
+ *
+ *  @return 0 on timeout, 1 otherwise.
+ */
 int waitforUDSX(int active)
 {
-	if(pShmem_data)
+	struct timespec timeout, poll;
+	uint64_t start;
+	unsigned int seen;
+	long remaining;
+	int done;
+
+	if (!pShmem_data || !active)
+	{
+		return 1;
+	}
+
+	start = MonotonicNs();
+
+	if (UdsxSyncAvailable())
+	{
+		seen = __atomic_load_n(&pShmem_data->udsx_cycle, __ATOMIC_ACQUIRE);
+		__atomic_add_fetch(&pShmem_data->udsx_waiters, 1, __ATOMIC_SEQ_CST);
+
+		while ((done = (__atomic_load_n(&pShmem_data->udsx_cycle, __ATOMIC_SEQ_CST) != seen)) == 0)
 		{
-			if(active)
+			remaining = UDSX_WAIT_TIMEOUT_US * 1000L - (long)MonotonicSince(start);
+			if (remaining <= 0)
 			{
-				pShmem_data->udsx_enter = 0;
-				pShmem_data->udsx_exit = 0;
-				while(pShmem_data->udsx_enter == 0 || pShmem_data->udsx_exit == 0)
-				{
-					;
-				};
+				break;
 			}
+			timeout.tv_sec = remaining / 1000000000L;
+			timeout.tv_nsec = remaining % 1000000000L;
+			//returns at once when the UDSX posted since the load above
+			syscall(SYS_futex, &pShmem_data->udsx_cycle, FUTEX_WAIT, seen, &timeout, NULL, 0);
+		}
+
+		__atomic_sub_fetch(&pShmem_data->udsx_waiters, 1, __ATOMIC_SEQ_CST);
+		return done;
+	}
+
+	__atomic_store_n(&pShmem_data->udsx_enter, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&pShmem_data->udsx_exit, 0, __ATOMIC_RELEASE);
+
+	poll.tv_sec = 0;
+	poll.tv_nsec = UDSX_POLL_US * 1000L;
+	while (__atomic_load_n(&pShmem_data->udsx_enter, __ATOMIC_ACQUIRE) == 0 ||
+		   __atomic_load_n(&pShmem_data->udsx_exit, __ATOMIC_ACQUIRE) == 0)
+	{
+		if (MonotonicSince(start) >= UDSX_WAIT_TIMEOUT_US * 1000ULL)
+		{
+			return 0;
 		}
+		nanosleep(&poll, NULL);
+	}
 
 	return 1;
 }
@@ -982,21 +1272,55 @@ int rushMemsearch(const char *hay, int haysize, const char *needle, int needlesi
 	return -1;
 }
 
-
-static void onData(dyad_Event *e)
+/**
+ *  @brief  Copy a frame payload into a fixed-size host array, at most destSize bytes of it.
+ *
+ *  @param  left    Bytes left in the received buffer from the payload on; a longer payload is not copied.
+ */
+static void rushCopyPayload(void *dest, int destSize, unsigned long int payload, int size, int left)
 {
-
-	char send_buffer_300[400];
+	if (size < 0 || size > left)
+	{
+		return;
+	}
+	if (size > destSize)
+	{
+		size = destSize;
+	}
+	memcpy(dest, (void*)payload, size);
+}
 
 
-	int pSend;
+static void onData(dyad_Event *e)
+{
 
 	unsigned long int start, oriStart;
 	int buffersize, oriSize;
 	int size = 0;
 	char flag;
 	char command;
-	int sentCount = 0;
+	AXIS_CMD axisCmd;
+	uint32_t version;
+	TELEM_FILTER_CFG filterCfg;
+	AXIS_DEF axisDef;
+	AXIS_PARAM_CFG paramCfg;
+	NODE_STATUS nodeStatus;
+	PATH_HEADER pathHeader;
+	AXIS_STATS_REQ statsReq;
+	static AXIS_STATS axisStats[AXIS_MAX];
+	int statsCount;
+	static char statsFrame[sizeof(axisStats) + 8];
+	TUNE_REQ tuneReq;
+	TUNE_RESULT tuneResult;
+	static char tuneFrame[sizeof(TUNE_RESULT) + 8];
+	ARM_REQ armReq;
+	SEQ_HEADER seqHeader;
+	SEQ_CTRL seqCtrl;
+	static char seqReply[sizeof(SEQ_STATUS) + SEQ_MAX_OPS * sizeof(SEQ_STEP_STATS)];
+	static char seqFrame[sizeof(seqReply) + 8];
+	char nodeFrame[sizeof(NODE_STATUS) + 16];
+	int pointer, node;
+	float cmdFlg[10];
 	int x;
 
 
@@ -1013,142 +1337,264 @@ static void onData(dyad_Event *e)
 			switch (flag)
 			{
 			case E_CMD_FLG:
-				memcpy(CMD_FLG, (void*)start, size);
+				//an axis left at 0 in a later frame of the cycle must not cancel an earlier command
+				if (size < 0 || size > buffersize)
+				{
+					break;
+				}
+				if (size > (int)sizeof(cmdFlg))
+				{
+					size = sizeof(cmdFlg);
+				}
+				memcpy(cmdFlg, (void*)start, size);
+				for (x = 0; x < (int)(size / sizeof(float)); x++)
+				{
+					if (cmdFlg[x] != 0)
+					{
+						CMD_FLG[x] = cmdFlg[x];
+					}
+				}
 				break;
 			case E_CTR_FLG:
-				memcpy(CTR_FLG, (void*)start, size);
+				rushCopyPayload(HostCtrFlg, sizeof(HostCtrFlg), start, size, buffersize);
 				break;
 			case E_FORCE_LIMIT:
-				memcpy(FORCE_LIMIT, (void*)start, size);
+				rushCopyPayload(HostForceLimit, sizeof(HostForceLimit), start, size, buffersize);
 				break;
 			case E_AXS_TYPE:
-				memcpy(AXS_TYPE, (void*)start, size);
+				rushCopyPayload(AXS_TYPE, sizeof(AXS_TYPE), start, size, buffersize);
 				break;
 			case E_AXS_NAM0:
-				memcpy(AXS_NAM0, (void*)start, size);
+				rushCopyPayload(AXS_NAM0, sizeof(AXS_NAM0), start, size, buffersize);
 				break;
 			case E_AXS_NAM1:
-				memcpy(AXS_NAM1, (void*)start, size);
+				rushCopyPayload(AXS_NAM1, sizeof(AXS_NAM1), start, size, buffersize);
 				break;
 			case E_AXS_NAM2:
-				memcpy(AXS_NAM2, (void*)start, size);
+				rushCopyPayload(AXS_NAM2, sizeof(AXS_NAM2), start, size, buffersize);
 				break;
 			case E_AXS_NAM3:
-				memcpy(AXS_NAM3, (void*)start, size);
+				rushCopyPayload(AXS_NAM3, sizeof(AXS_NAM3), start, size, buffersize);
 				break;
 			case E_AXS_NAM4:
-				memcpy(AXS_NAM4, (void*)start, size);
+				rushCopyPayload(AXS_NAM4, sizeof(AXS_NAM4), start, size, buffersize);
 				break;
 			case E_AXS_NAM5:
-				memcpy(AXS_NAM5, (void*)start, size);
+				rushCopyPayload(AXS_NAM5, sizeof(AXS_NAM5), start, size, buffersize);
 				break;
 			case E_AXS_NAM6:
-				memcpy(AXS_NAM6, (void*)start, size);
+				rushCopyPayload(AXS_NAM6, sizeof(AXS_NAM6), start, size, buffersize);
 				break;
 			case E_AXS_NAM7:
-				memcpy(AXS_NAM7, (void*)start, size);
+				rushCopyPayload(AXS_NAM7, sizeof(AXS_NAM7), start, size, buffersize);
 				break;
 			case E_AXS_NAM8:
-				memcpy(AXS_NAM8, (void*)start, size);
+				rushCopyPayload(AXS_NAM8, sizeof(AXS_NAM8), start, size, buffersize);
 				break;
 			case E_AXS_NAM9:
-				memcpy(AXS_NAM9, (void*)start, size);
+				rushCopyPayload(AXS_NAM9, sizeof(AXS_NAM9), start, size, buffersize);
 				break;
 			case E_REQ_STAT:
-				memcpy(&command, (void*)start, size);
+				if (size != sizeof(char) || size > buffersize)
+				{
+					break;
+				}
+				memcpy(&command, (void*)start, sizeof(char));
 				switch (command){
 				case E_NYCE_INIT:
-					sys_case = SYS_INIT;
+					HostRequestSysCase(SYS_INIT);
 					break;
 				case E_NYCE_STOP:
-					sys_case = SYS_STOP;
+					HostRequestSysCase(SYS_STOP);
 					break;
 				}
 				break;
-			}
-		}
-		else
-			break;
-
-		if (buffersize <= 0)
-		{
-			break;
-		}
-	}
-
-	if (pShmem_data)
-	{
-		memcpy(&pShmem_data->FORCE_LIMIT[0], &FORCE_LIMIT[0], sizeof(FORCE_LIMIT));
-	}
-
-	NyceMainLoop();
-
-
-
-
-//	char send_buffer_300[300];
-
-
-//	int pSend;
-//	int sentCount = 0;
-//	int x;
-
-	memset(send_buffer_300, 0, sizeof(send_buffer_300));
-
-		pSend = 0;
-		sentCount = 0;
-		if (pShmem_data){
-			for(x = 0 ; x<10 ; x++)
-			{
-				if(pShmem_data->STAT_FLG[x] != OLD_STAT_FLG[x])
+			case E_AXIS_CMD:
+				for (x = 0; x + (int)sizeof(AXIS_CMD) <= size; x += sizeof(AXIS_CMD))
 				{
-					rushMakeBuffer(send_buffer_300, &pShmem_data->STAT_FLG, &pSend, sizeof(unsigned int) * 10, E_STAT_FLG);
-					memcpy(OLD_STAT_FLG,pShmem_data->STAT_FLG,sizeof(OLD_STAT_FLG));
-					break;
+					memcpy(&axisCmd, (char*)start + x, sizeof(AXIS_CMD));
+					if (axisCmd.axis < 0 || axisCmd.axis >= AxisCount)
+					{
+						continue;
+					}
+					if (!ControlPush(&axisCmd))
+					{
+						logging(axisCmd.axis,(float)axisCmd.opcode,"control queue full","onData");  ////////////////log
+					}
 				}
-			}
-
-			if (sentCount == 0)
-			{
-				rushMakeBuffer(send_buffer_300, &pShmem_data->VC_POS, &pSend, sizeof(float) * 20, E_VC_POS);
-				for(x = 0 ; x<10 ; x++)
+				break;
+			case E_SYNC_ACK:
+				if (size == sizeof(uint32_t))
+				{
+					memcpy(&version, (void*)start, size);
+					TelemAck(e->udata, version);
+				}
+				break;
+			case E_TELEM_FILTER:
+				if (size == sizeof(TELEM_FILTER_CFG))
+				{
+					memcpy(&filterCfg, (void*)start, size);
+					if (!TelemSetFilter(&filterCfg))
+					{
+						logging(100,(float)filterCfg.channel,"invalid telemetry filter","onData");  ////////////////log
+					}
+				}
+				break;
+			case E_AXIS_DEF:
+				if (size == sizeof(AXIS_DEF))
+				{
+					memcpy(&axisDef, (void*)start, size);
+					if (!AxisDefine(&axisDef))
+					{
+						logging(axisDef.axis,(float)axisDef.type,"invalid axis definition","onData");  ////////////////log
+					}
+				}
+				break;
+			case E_AXIS_PARAM:
+				if (size == sizeof(AXIS_PARAM_CFG))
 				{
-					if(pShmem_data->NET_CURRENT[x] != OLD_NET_CURRENT[x])
+					memcpy(&paramCfg, (void*)start, size);
+					if (paramCfg.axis < 0 || paramCfg.axis >= AxisCount || paramCfg.param < 0 || paramCfg.param >= AXIS_PAR_COUNT)
 					{
-						rushMakeBuffer(send_buffer_300, &pShmem_data->NET_CURRENT, &pSend, sizeof(float) * 10, E_NET_CURRENT);
-						memcpy(OLD_NET_CURRENT,pShmem_data->NET_CURRENT,sizeof(OLD_NET_CURRENT));
+						logging(paramCfg.axis,(float)paramCfg.param,"invalid axis parameter","onData");  ////////////////log
 						break;
 					}
+					AxisSetParam(paramCfg.axis, paramCfg.param, paramCfg.value);
 				}
-
-			}
-			sentCount++;
-			if (sentCount >= 70)
-			{
-				sentCount = 0;
+				break;
+			case E_NODE_STAT:
+				if (size == sizeof(int))
+				{
+					memcpy(&node, (void*)start, size);
+					if (NodeReadStatus(node, &nodeStatus))
+					{
+						pointer = 0;
+						rushMakeBuffer(nodeFrame, (char*)&nodeStatus, &pointer, sizeof(nodeStatus), E_NODE_STAT);
+						dyad_write(e->stream, nodeFrame, pointer);
+					}
+				}
+				break;
+			case E_AXIS_PATH:
+				if (size >= (int)sizeof(PATH_HEADER) && size <= buffersize)
+				{
+					memcpy(&pathHeader, (void*)start, sizeof(PATH_HEADER));
+					if (pathHeader.count < 0 || pathHeader.count > PATH_MAX_POINTS
+						|| size != (int)(sizeof(PATH_HEADER) + pathHeader.count * sizeof(PATH_POINT))
+						|| !PathLoad(&pathHeader, (const PATH_POINT*)((char*)start + sizeof(PATH_HEADER))))
+					{
+						logging(pathHeader.axis,(float)pathHeader.count,"invalid axis path","onData");  ////////////////log
+					}
+				}
+				break;
+			case E_AXIS_ARM:
+				if (size == sizeof(ARM_REQ))
+				{
+					memcpy(&armReq, (void*)start, size);
+					if (!ArmLoad(&armReq))
+					{
+						logging(armReq.cmd.axis,(float)armReq.trigger,"invalid armed command","onData");  ////////////////log
+					}
+				}
+				break;
+			case E_SEQ_LOAD:
+				if (size >= (int)sizeof(SEQ_HEADER) && size <= buffersize)
+				{
+					memcpy(&seqHeader, (void*)start, sizeof(SEQ_HEADER));
+					if (seqHeader.count < 0 || seqHeader.count > SEQ_MAX_OPS
+						|| size != (int)(sizeof(SEQ_HEADER) + seqHeader.count * sizeof(SEQ_OP))
+						|| !SeqLoad(&seqHeader, (const SEQ_OP*)((char*)start + sizeof(SEQ_HEADER))))
+					{
+						logging(100,(float)seqHeader.count,"invalid sequence program","onData");  ////////////////log
+					}
+				}
+				break;
+			case E_SEQ_CTRL:
+				if (size == sizeof(SEQ_CTRL))
+				{
+					memcpy(&seqCtrl, (void*)start, size);
+					if (SeqControl(&seqCtrl, (SEQ_STATUS*)seqReply, (SEQ_STEP_STATS*)(seqReply + sizeof(SEQ_STATUS))))
+					{
+						pointer = 0;
+						rushMakeBuffer(seqFrame, seqReply, &pointer,
+									   sizeof(SEQ_STATUS) + ((SEQ_STATUS*)seqReply)->count * sizeof(SEQ_STEP_STATS), E_SEQ_CTRL);
+						dyad_write(e->stream, seqFrame, pointer);
+					}
+				}
+				break;
+			case E_TRACE_SUB:
+				if (size == sizeof(char))
+				{
+					memcpy(&command, (void*)start, size);
+					TelemSubscribe(e->udata, TELEM_SUB_TRACE, command);
+				}
+				break;
+			case E_AXIS_STATS:
+				if (size == sizeof(AXIS_STATS_REQ))
+				{
+					memcpy(&statsReq, (void*)start, size);
+					statsCount = 0;
+					for (x = (statsReq.axis < 0) ? 0 : statsReq.axis; x < AxisCount && (statsReq.axis < 0 || x == statsReq.axis); x++)
+					{
+						AxisStatsRead(x, &axisStats[statsCount++]);
+					}
+					if (statsReq.flags & AXIS_STATS_EXPORT)
+					{
+						AxisStatsExport(AXIS_STATS_CSV);
+					}
+					if (statsReq.flags & AXIS_STATS_RESET)
+					{
+						AxisStatsReset(statsReq.axis);
+					}
+					pointer = 0;
+					rushMakeBuffer(statsFrame, (char*)axisStats, &pointer, statsCount * sizeof(AXIS_STATS), E_AXIS_STATS);
+					dyad_write(e->stream, statsFrame, pointer);
+				}
+				break;
+			case E_MOVE_SUB:
+				if (size == sizeof(char))
+				{
+					memcpy(&command, (void*)start, size);
+					TelemSubscribe(e->udata, TELEM_SUB_MOVE, command);
+				}
+				break;
+			case E_AXIS_TUNE:
+				if (size == sizeof(TUNE_REQ))
+				{
+					memcpy(&tuneReq, (void*)start, size);
+					if (TuneRequest(&tuneReq, &tuneResult))
+					{
+						pointer = 0;
+						rushMakeBuffer(tuneFrame, (char*)&tuneResult, &pointer, sizeof(TUNE_RESULT), E_AXIS_TUNE);
+						dyad_write(e->stream, tuneFrame, pointer);
+					}
+				}
+				break;
 			}
 		}
+		else
+			break;
 
-//		for(x = 0 ; x<10 ; x++)
-//		{
-//			if(CMD_FLG[x] != OLD_CMD_FLG[x])
-//			{
-//				rushMakeBuffer(send_buffer_300, CMD_FLG, &pSend, sizeof(float) * 10, E_CMD_FLG);
-//				memcpy(OLD_CMD_FLG,CMD_FLG,sizeof(OLD_CMD_FLG));
-//				break;
-//			}
-//		}
-
-
-		rushMakeBuffer(send_buffer_300, &sys_case, &pSend, sizeof(char) * 1, E_SYS_CASE);
-		dyad_write(e->stream, send_buffer_300, pSend);
-
+		if (buffersize <= 0)
+		{
+			break;
+		}
+	}
 
+	NyceStageCommands();
 
+	TelemRequestReply(e->udata);
 }
 
 static void onAccept(dyad_Event *e) {
-	dyad_addListener(e->remote, DYAD_EVENT_DATA, onData, NULL);
+	TELEM_SESSION *session = TelemAttach(e->remote, TelemStreamWrite);
+	if (session == NULL)
+	{
+		logging(100,TELEM_MAX_SESSIONS,"Too many clients","onAccept");  ////////////////log
+		dyad_close(e->remote);
+		return;
+	}
+	dyad_addListener(e->remote, DYAD_EVENT_DATA, onData, session);
+	dyad_addListener(e->remote, DYAD_EVENT_CLOSE, onClose, session);
 	//dyad_addListener(e->remote, DYAD_EVENT_DATA, onReady, NULL);
 	int opt = 1;
 	dyad_setNoDelay(e->remote, opt);
@@ -1166,4 +1612,8 @@ static void onReady(dyad_Event *e){
 ;
 }
 
+static void onClose(dyad_Event *e) {
+	TelemDetach(e->udata);
+}
+
 
@@ -16,9 +16,17 @@
 #ifndef _MY_UDSX_INTERFACE_H_
 #define _MY_UDSX_INTERFACE_H_
 
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <n4k_basictypes.h>
 #include <nycedefs.h>
 #include <nhivariables.h>
+#include <sactypes.h>
 #include "dyad.h"
 
 /* Helper macros */
@@ -75,9 +83,23 @@ typedef struct axis_setting{
 	char				Shared_AxisName9[20];
 }AXIS_SETTING;
 
+/* Shared_AxisName0..9 of an AXIS_SETTING or SHMEM_DATA as an array initializer */
+#define AXIS_NAME_TABLE(s)	{ (s)->Shared_AxisName0, (s)->Shared_AxisName1, (s)->Shared_AxisName2, (s)->Shared_AxisName3, \
+							  (s)->Shared_AxisName4, (s)->Shared_AxisName5, (s)->Shared_AxisName6, (s)->Shared_AxisName7, \
+							  (s)->Shared_AxisName8, (s)->Shared_AxisName9 }
+
 
 #define		SHMEM_AREA		2
 
+/* Channels of SHMEM_DATA written by the UDSX */
+enum SHM_CHANNEL{
+	SHM_CH_STAT_FLG,
+	SHM_CH_VC_POS,
+	SHM_CH_NET_CURRENT,
+
+	SHM_CH_COUNT
+};
+
 typedef struct shmem_data
 {
 	unsigned int		Shared_StatFlag[10];
@@ -100,52 +122,122 @@ typedef struct shmem_data
 	float 				NET_CURRENT[10];
 	int					udsx_enter;
 	int					udsx_exit;
+	unsigned int		gen_magic;					/* SHM_GEN_MAGIC when the UDSX maintains channel_gen */
+	unsigned int		channel_gen[SHM_CH_COUNT];	/* odd while the UDSX writes a channel, see ShmWriteBegin */
+	unsigned int		sync_magic;					/* SHM_SYNC_MAGIC when the UDSX posts udsx_cycle */
+	unsigned int		udsx_cycle;					/* futex word, incremented at the end of every UDSX cycle */
+	unsigned int		udsx_waiters;				/* server threads sleeping on udsx_cycle */
 } SHMEM_DATA;
 
+/*
+ * Channel generations, a sequence counter per channel.
+ * The UDSX brackets every write of a channel array, so the generation is odd while the array is written:
+ *     ShmWriteBegin(pShmem_data, SHM_CH_STAT_FLG); ...write STAT_FLG...; ShmWriteEnd(pShmem_data, SHM_CH_STAT_FLG);
+ * A reader copies the array between two loads of an even, unchanged generation, and compares one integer
+ * per channel instead of the arrays. A UDSX that does not publish SHM_GEN_MAGIC, including one built for
+ * the single-bump "GEN1" protocol, is read without generations and the server derives them itself.
+ */
+#define SHM_GEN_MAGIC	0x47454E32	/* "GEN2" */
+
+static inline void ShmWriteBegin(SHMEM_DATA *shm, int channel)
+{
+	__atomic_fetch_add(&shm->channel_gen[channel], 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void ShmWriteEnd(SHMEM_DATA *shm, int channel)
+{
+	__atomic_fetch_add(&shm->channel_gen[channel], 1, __ATOMIC_RELEASE);
+}
+
+static inline unsigned int ShmLoadGen(const SHMEM_DATA *shm, int channel)
+{
+	return __atomic_load_n(&shm->channel_gen[channel], __ATOMIC_ACQUIRE);
+}
+
+/* Attempts of ShmReadChannel before it gives up on a channel the UDSX keeps writing */
+#define SHM_READ_RETRIES	3
+
+/*
+ * Copy size bytes at src, inside the array of channel, between two loads of an even, unchanged generation.
+ * Returns 0 when every attempt overlapped a write of the UDSX; dst is then torn and must not be used.
+ */
+static inline int ShmReadChannel(const SHMEM_DATA *shm, int channel, void *dst, const void *src, size_t size, unsigned int *gen)
+{
+	int attempt;
+
+	for (attempt = 0; attempt < SHM_READ_RETRIES; attempt++)
+	{
+		*gen = ShmLoadGen(shm, channel);
+		if (*gen & 1)
+		{
+			continue;
+		}
+		memcpy(dst, src, size);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&shm->channel_gen[channel], __ATOMIC_RELAXED) == *gen)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Cycle handshake, replaces the udsx_enter/udsx_exit spin.
+ * The UDSX calls ShmPostCycle(pShmem_data) at the end of each cycle. The FUTEX_WAKE system call is only
+ * made when a server thread is sleeping in waitforUDSX, so an unobserved cycle costs one atomic add.
+ * The futex is process-shared (no FUTEX_PRIVATE_FLAG), the word lives in the shared memory.
+ */
+#define SHM_SYNC_MAGIC	0x53594E31	/* "SYN1" */
+
+static inline void ShmPostCycle(SHMEM_DATA *shm)
+{
+	__atomic_fetch_add(&shm->udsx_cycle, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&shm->udsx_waiters, __ATOMIC_SEQ_CST) != 0)
+	{
+		syscall(SYS_futex, &shm->udsx_cycle, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+	}
+}
 
-unsigned int		OLD_STAT_FLG[10];
-float				OLD_NET_CURRENT[10];
-float				OLD_CMD_FLG[10];
+extern SHMEM_DATA*		pShmem_data;			/* node 0 */
+extern unsigned int		nodeId;
+extern size_t			g_sharedMemorySize;
+extern char				sys_case;
 
-int resp_cmd;
-float 				FORCE_LIMIT[10];
+
+extern unsigned int		OLD_STAT_FLG[10];
+extern float				OLD_NET_CURRENT[10];
+extern float				OLD_CMD_FLG[10];
+
+extern int resp_cmd;
+extern float 				FORCE_LIMIT[10];
 ///nyce main loop
 
-float CMD_FLG[10];
-float CTR_FLG[80];
-char  AXS_NAM0[20];
-char  AXS_NAM1[20];
-char  AXS_NAM2[20];
-char  AXS_NAM3[20];
-char  AXS_NAM4[20];
-char  AXS_NAM5[20];
-char  AXS_NAM6[20];
-char  AXS_NAM7[20];
-char  AXS_NAM8[20];
-char  AXS_NAM9[20];
-int   AXS_TYPE[10];
-
-char  TempName0[20];
-char  TempName1[20];
-char  TempName2[20];
-char  TempName3[20];
-char  TempName4[20];
-char  TempName5[20];
-char  TempName6[20];
-char  TempName7[20];
-char  TempName8[20];
-char  TempName9[20];
-int   TempAxType;
-
-float LAST_VC_POS[20];
-unsigned int LAST_STAT_FLG[10];
-
-NYCE_STATUS StatusSDisconnect[10];
-NYCE_STATUS StatusSConnect[10];
-NYCE_STATUS StatusPtp[10];
-NYCE_STATUS StatusOpenLoop[10];
-NYCE_STATUS StatusLock[10];
-NYCE_STATUS StatusWParameter[10];
+extern float CMD_FLG[10];
+extern float CTR_FLG[80];
+extern char  AXS_NAM0[20];
+extern char  AXS_NAM1[20];
+extern char  AXS_NAM2[20];
+extern char  AXS_NAM3[20];
+extern char  AXS_NAM4[20];
+extern char  AXS_NAM5[20];
+extern char  AXS_NAM6[20];
+extern char  AXS_NAM7[20];
+extern char  AXS_NAM8[20];
+extern char  AXS_NAM9[20];
+extern int   AXS_TYPE[10];
+
+extern float LAST_VC_POS[20];
+extern unsigned int LAST_STAT_FLG[10];
+
+/* per-axis arrays, AxisCount elements allocated by AxisRegistryInit (axisRegistry.h) */
+extern NYCE_STATUS *StatusSDisconnect;
+extern NYCE_STATUS *StatusSConnect;
+extern NYCE_STATUS *StatusPtp;
+extern NYCE_STATUS *StatusOpenLoop;
+extern NYCE_STATUS *StatusLock;
+extern NYCE_STATUS *StatusWParameter;
 
 #define NyceNoError 0
 
@@ -159,34 +251,78 @@ NYCE_STATUS StatusWParameter[10];
 #define OpenLoop	3
 #define AxisLock	4
 
-float oldCmdPos[10];
-float oldPtpPos[10];
+/* Axis command opcodes of E_AXIS_CMD */
+enum AXIS_OPCODE{
+	OP_MOVE,
+	OP_CHG_WORK_POS,
+	OP_OPEN_LOOP,
+	OP_LOCK,
+
+	OP_COUNT
+};
 
-int Axis_Type[10];
-char Axis_Name[10][20];
-int SacConnected[10];
-int SacMovedCnt[10];
-int Cmd_Toggle[10];
+/*
+ * AXIS_CMD opcode: AXIS_OPCODE in the low byte, the profile of a move (PROFILE_KIND + 1, profile.h) above it.
+ * 0 there leaves the choice to AXIS_PAR_PROFILE of the axis, so the commands of older clients are unchanged.
+ */
+#define AXIS_OP_MASK			0xFF
+#define AXIS_OP_PROFILE_SHIFT	8
+
+#define AXIS_CMD_OPCODE(cmd)	((cmd)->opcode & AXIS_OP_MASK)
+#define AXIS_CMD_PROFILE(cmd)	(((cmd)->opcode >> AXIS_OP_PROFILE_SHIFT) - 1)		/* -1 when the command has none */
+
+/**
+ * @brief   Explicit axis command, the payload of E_AXIS_CMD (one or more per frame).
+ *          Replaces the float encoding CMD_FLG[ax] = type*10000 + position, which is still accepted.
+ */
+typedef struct axis_cmd
+{
+	int					axis;
+	int					opcode;				/**< AXIS_OPCODE, with the profile of a move, see AXIS_CMD_PROFILE */
+	double				position;			/**< Target, or new work position for OP_CHG_WORK_POS */
+	float				distance;			/**< Default distance of the profile, 0 uses AXIS_PAR_DEF_DISTANCE */
+	float				duration;			/**< Default duration of the profile, 0 uses AXIS_PAR_DEF_DURATION */
+} AXIS_CMD;
 
-double distance[10];
-double duration[10];
-double ratio[10];
+typedef void (*AXIS_HANDLER)(const AXIS_CMD *cmd);
 
+extern AXIS_HANDLER (*AxisHandler)[OP_COUNT];
+/* Axis commands taken over by the control thread, executed in order by NyceMainLoop */
+#define AXIS_CMD_QUEUE	64
 
-SAC_AXIS		sacAxis[10];
-SAC_PTP_PARS	m_sacPtpPars[20];
+extern AXIS_CMD AxisCmdQueue[AXIS_CMD_QUEUE];
+extern int AxisCmdCount;
 
-float SPEED_FACTOR;
-float STANDBY_POS[10];
+extern float *oldCmdPos;
+extern float *oldPtpPos;
 
-void ExeParabolicProfile(int AxisID);
+extern int *Axis_Type;
+extern char (*Axis_Name)[20];
+extern int *SacConnected;
+extern int *SacMovedCnt;
+extern int *Cmd_Toggle;
+extern char (*ConnectedName)[20];		//name and type each sacAxis handle was connected with
+extern int *ConnectedType;
+
+extern double *distance;
+extern double *duration;
+extern double *ratio;
+
+
+extern SAC_AXIS		*sacAxis;
+extern SAC_PTP_PARS	*m_sacPtpPars;
+
+extern float SPEED_FACTOR;
+extern float *STANDBY_POS;				//AXIS_PAR_STANDBY_POS
+
+void AxisBuildHandlers(void);
 void EndForceUDSX(void);
 void AxisInit(void);
 
 
-int Init;
-int Ready;
-int stop_eth;
+extern int Init;
+extern int Ready;
+extern int stop_eth;
 
 
 enum E_CMD{
@@ -217,6 +353,29 @@ enum E_CMD{
 	E_REQ_STAT,
 	E_SYS_CASE,
 
+	E_TRACE_SUB,
+	E_TRACE,
+
+	E_AXIS_CMD,
+
+	E_SYNC_ACK,
+	E_SNAPSHOT,
+	E_DELTA,
+	E_TELEM_FILTER,
+
+	E_AXIS_DEF,
+	E_AXIS_PARAM,
+	E_NODE_STAT,
+	E_AXIS_PATH,
+
+	E_MOVE_SUB,
+	E_MOVE_EVENT,
+	E_AXIS_STATS,
+	E_AXIS_TUNE,
+	E_AXIS_ARM,
+	E_SEQ_LOAD,
+	E_SEQ_CTRL,
+
 	E_PING = 4114,
 
 };
@@ -242,41 +401,43 @@ enum SEQ_SYS{
 
 
 
-FILE *logfile;
-char oldlogmsg[180];
+extern FILE *logfile;
+extern char oldlogmsg[180];
 
 void DieWithError(char* errorMessage); /* Error handling function */
 void NyceMainLoop(void);
+void NyceApplyCommands(void);
+void NyceStageCommands(void);
+void NyceEndCycle(void);
+void ReactorPause(void);
+void ReactorResume(void);
 int NyceDisconnectAxis(void);
 int waitforUDSX(int active);
+int UdsxSyncAvailable(void);
 int initLogFile(void);
 int logging(int axis,float payload,const char* msg,const char* retval);
 int memsearch(const char *hay, int haysize, const char *needle, int needlesize);
 int closeLogFile(void);
 uint32_t GetTimeStamp_ms();
 
-int debug;
+extern int debug;
 
 
 #define max_ports 10
 #define max_clients 20
 
 
-int master_socket[max_ports];
-int client_socket[max_clients];
-int server_port_list[max_clients];
-int ports[max_ports];
-fd_set readfds;
+extern int master_socket[max_ports];
+extern int client_socket[max_clients];
+extern int server_port_list[max_clients];
+extern int ports[max_ports];
+extern fd_set readfds;
 
-char nodeAddress[80];
+extern char nodeAddress[80];
 
 void rushMakeBuffer(char* bufferout, char* bufferin, int* pointer, int size, char flag);
 int rushSearchBuffer(unsigned long int* start, int* buffersize, int* size, char *flag, unsigned long int oriStart, int oriSize);
 int rushMemsearch(const char *hay, int haysize, const char *needle, int needlesize);
-static void onData(dyad_Event *e);
-static void onAccept(dyad_Event *e);
-static void onError(dyad_Event *e);
-static void onReady(dyad_Event *e);
 void updateThreadFunc(void);
 
 #endif
@@ -0,0 +1,445 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Sequence programs, see sequence.h.
+ *
+ *  SeqLoad and SeqControl run on the reactor. They leave the program in the upload slot of g_handoff and
+ *  the requests for SeqPoll on the control thread, which alone runs the program and publishes its status
+ *  under g_seqLock.
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "rushEmb.h"
+#include "sequence.h"
+#include "axisRegistry.h"
+#include "profile.h"
+#include "node.h"
+#include "handoff.h"
+#include "monotonic.h"
+
+/* SeqPoll requests */
+#define SEQ_REQ_START			0x01
+#define SEQ_REQ_ABORT			0x02
+#define SEQ_REQ_RESET			0x04
+
+/* SeqStep results besides the next op */
+#define SEQ_STEP_WAIT			-1
+#define SEQ_STEP_END			-2
+#define SEQ_STEP_ABORT			-3
+
+typedef struct seq_program
+{
+	int					count;
+	SEQ_OP				ops[SEQ_MAX_OPS];
+} SEQ_PROGRAM;
+
+typedef struct seq_run
+{
+	SEQ_PROGRAM			program;
+	SEQ_STATUS			status;
+	SEQ_STEP_STATS		steps[SEQ_MAX_OPS];
+	uint32_t			loops[SEQ_MAX_OPS];		/**< Jumps taken by each SEQ_LOOP */
+	uint64_t			runStart_ns;
+	uint64_t			stepStart_ns;			/**< 0 until the current op is first executed */
+	uint64_t			moveStart_ns[AXIS_MAX];	/**< Last SEQ_MOVE of each axis */
+	int					moveCount[AXIS_MAX];	/**< SacMovedCnt before the last SEQ_MOVE of each axis */
+	AXIS_MASK			moved;					/**< Axes with a SEQ_MOVE in this run */
+	int					dirty;					/**< status or steps changed since the last publish */
+} SEQ_RUN;
+
+static SEQ_PROGRAM			g_upload;				// reactor, under g_handoff
+static int					g_uploadStart;			// SEQ_HEADER.start of g_upload
+static HANDOFF				g_handoff = HANDOFF_INITIALIZER;
+static pthread_mutex_t		g_seqLock = PTHREAD_MUTEX_INITIALIZER;
+static SEQ_STATUS			g_status;				// published, under g_seqLock
+static SEQ_STEP_STATS		g_steps[SEQ_MAX_OPS];
+static int					g_request = 0;
+
+static SEQ_RUN				g_run;					// control thread
+
+
+/**
+ *  @brief  Whether none of the ops first ... last waits or delays. Run in an endless SEQ_LOOP they would
+ *          spin every control cycle, and flood the AxisCmdQueue with a SEQ_MOVE among them.
+ */
+static int SeqWithoutWait(const SEQ_OP *ops, int first, int last)
+{
+	int i;
+
+	for (i = first; i <= last; i++)
+	{
+		switch (ops[i].op)
+		{
+			case SEQ_WAIT_MOVE:
+			case SEQ_WAIT_STAT:
+			case SEQ_WAIT_ABOVE:
+			case SEQ_WAIT_BELOW:
+			case SEQ_DELAY:
+				return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ *  @brief  Check a program and store it, taken over in the next control cycle. Reactor thread.
+ *
+ *  @return 0 when an op is invalid, or an endless SEQ_LOOP runs without waiting.
+ */
+int SeqLoad(const SEQ_HEADER *header, const SEQ_OP *ops)
+{
+	int i;
+	const SEQ_OP *op;
+
+	if (header->count < 0 || header->count > SEQ_MAX_OPS)
+	{
+		return 0;
+	}
+
+	for (i = 0; i < header->count; i++)
+	{
+		op = &ops[i];
+		if (op->op < SEQ_END || op->op > SEQ_LOOP
+			|| (op->op != SEQ_END && op->op != SEQ_DELAY && op->op != SEQ_LOOP && (op->axis < 0 || op->axis >= AxisCount)))
+		{
+			return 0;
+		}
+
+		switch (op->op)
+		{
+			case SEQ_MOVE:
+				if ((op->arg & AXIS_OP_MASK) >= OP_COUNT || (op->arg >> AXIS_OP_PROFILE_SHIFT) - 1 >= PROFILE_COUNT)
+				{
+					return 0;
+				}
+				break;
+			case SEQ_WAIT_STAT:
+			case SEQ_WAIT_ABOVE:
+			case SEQ_WAIT_BELOW:
+				if (!AxisHasUdsx(op->axis))
+				{
+					return 0;
+				}
+				break;
+			case SEQ_SET_PARAM:
+				if (op->arg < 0 || op->arg >= AXIS_PAR_COUNT)
+				{
+					return 0;
+				}
+				break;
+			case SEQ_LOOP:
+				if (op->arg < 0 || op->arg >= header->count
+					|| (op->value == 0 && op->arg <= i && SeqWithoutWait(ops, op->arg, i)))
+				{
+					return 0;
+				}
+				break;
+		}
+	}
+
+	HandoffLock(&g_handoff);
+	g_upload.count = header->count;
+	memcpy(g_upload.ops, ops, header->count * sizeof(SEQ_OP));
+	g_uploadStart = header->start ? 1 : 0;
+	HandoffPost(&g_handoff, 0);
+	return 1;
+}
+
+/**
+ *  @brief  Pass a request to the control thread and report the status. Reactor thread.
+ *
+ *  @param  steps   SEQ_MAX_OPS entries, status->count of them are filled
+ *  @return 0 when the command is invalid.
+ */
+int SeqControl(const SEQ_CTRL *ctrl, SEQ_STATUS *status, SEQ_STEP_STATS *steps)
+{
+	static const int requests[] = { 0, SEQ_REQ_START, SEQ_REQ_ABORT, SEQ_REQ_RESET };
+
+	if (ctrl->command < SEQ_CTRL_STATUS || ctrl->command > SEQ_CTRL_RESET_STATS)
+	{
+		return 0;
+	}
+	__atomic_or_fetch(&g_request, requests[ctrl->command], __ATOMIC_RELEASE);
+
+	pthread_mutex_lock(&g_seqLock);
+	*status = g_status;
+	memcpy(steps, g_steps, g_status.count * sizeof(SEQ_STEP_STATS));
+	pthread_mutex_unlock(&g_seqLock);
+	return 1;
+}
+
+/**
+ *  @brief  Abort the program at the start of the next control cycle, on a system stop.
+ */
+void SeqClearAll(void)
+{
+	HandoffClear(&g_handoff);
+}
+
+static void SeqAbort(int error)
+{
+	g_run.status.state = SEQ_ABORTED;
+	g_run.status.error = error;
+	g_run.dirty = 1;
+	logging(g_run.status.pc,(float)error,"sequence aborted at op","SeqAbort");  ////////////////log
+}
+
+static void SeqResetStats(void)
+{
+	g_run.status.runs = 0;
+	g_run.status.run_last = 0;
+	g_run.status.run_max = 0;
+	memset(g_run.steps, 0, sizeof(g_run.steps));
+	g_run.dirty = 1;
+}
+
+/**
+ *  @brief  Execute the op at pc.
+ *
+ *  @return The next op, or SEQ_STEP_WAIT, SEQ_STEP_END, SEQ_STEP_ABORT.
+ */
+static int SeqStep(int pc, uint64_t now)
+{
+	const SEQ_OP *op = &g_run.program.ops[pc];
+	int ax = op->axis;
+	SHMEM_DATA *shm = (op->op == SEQ_WAIT_STAT || op->op == SEQ_WAIT_ABOVE || op->op == SEQ_WAIT_BELOW) ? NodeShmOfAxis(ax) : NULL;
+	AXIS_CMD *cmd;
+
+	switch (op->op)
+	{
+		case SEQ_END:
+			return SEQ_STEP_END;
+
+		case SEQ_MOVE:
+			if (SacConnected[ax] != 255)
+			{
+				SeqAbort(SEQ_ERR_AXIS);
+				return SEQ_STEP_ABORT;
+			}
+			if (AxisCmdCount >= AXIS_CMD_QUEUE)
+			{
+				return SEQ_STEP_WAIT;
+			}
+			cmd = &AxisCmdQueue[AxisCmdCount++];
+			cmd->axis = ax;
+			cmd->opcode = op->arg;
+			cmd->position = op->position;
+			cmd->distance = op->distance;
+			cmd->duration = op->duration;
+			g_run.moveStart_ns[ax] = now;
+			g_run.moveCount[ax] = SacMovedCnt[ax];
+			g_run.moved |= AXIS_BIT(ax);
+			return pc + 1;
+
+		case SEQ_WAIT_MOVE:
+			if (SacConnected[ax] != 255)
+			{
+				SeqAbort(SEQ_ERR_AXIS);
+				return SEQ_STEP_ABORT;
+			}
+			//planned and issued by NyceMainLoop after SeqPoll, at the earliest in this cycle
+			if (AxisCmdQueued() & AXIS_BIT(ax))
+			{
+				return SEQ_STEP_WAIT;
+			}
+			//AxisExecute dropped the move, e.g. the system is no longer ready; StatusPtp is of an older one
+			if ((g_run.moved & AXIS_BIT(ax)) && SacMovedCnt[ax] == g_run.moveCount[ax])
+			{
+				SeqAbort(SEQ_ERR_MOVE);
+				return SEQ_STEP_ABORT;
+			}
+			if (NyceError(StatusPtp[ax]))
+			{
+				SeqAbort(SEQ_ERR_MOVE);
+				return SEQ_STEP_ABORT;
+			}
+			if (now - g_run.moveStart_ns[ax] < duration[ax] * 1e9 || (AxisHasUdsx(ax) && !(*AxisStatFlag(ax) & 0x01)))
+			{
+				return SEQ_STEP_WAIT;
+			}
+			return pc + 1;
+
+		case SEQ_WAIT_STAT:
+		case SEQ_WAIT_ABOVE:
+		case SEQ_WAIT_BELOW:
+			if (shm == NULL)
+			{
+				SeqAbort(SEQ_ERR_AXIS);
+				return SEQ_STEP_ABORT;
+			}
+			if (op->op == SEQ_WAIT_STAT)
+			{
+				return ((__atomic_load_n(&shm->STAT_FLG[ax % AXIS_LEGACY_COUNT], __ATOMIC_ACQUIRE) & (uint32_t)op->arg) == op->value) ? pc + 1 : SEQ_STEP_WAIT;
+			}
+			if (op->op == SEQ_WAIT_ABOVE)
+			{
+				return (shm->NET_CURRENT[ax % AXIS_LEGACY_COUNT] >= op->position) ? pc + 1 : SEQ_STEP_WAIT;
+			}
+			return (shm->NET_CURRENT[ax % AXIS_LEGACY_COUNT] <= op->position) ? pc + 1 : SEQ_STEP_WAIT;
+
+		case SEQ_DELAY:
+			return (now - g_run.stepStart_ns >= op->duration * 1e9) ? pc + 1 : SEQ_STEP_WAIT;
+
+		case SEQ_SET_PARAM:
+			AxisSetParam(ax, op->arg, (float)op->position);
+			return pc + 1;
+
+		case SEQ_LOOP:
+			if (op->value == 0)
+			{
+				return op->arg;
+			}
+			if (g_run.loops[pc] < op->value)
+			{
+				g_run.loops[pc]++;
+				return op->arg;
+			}
+			g_run.loops[pc] = 0;
+			return pc + 1;
+	}
+	return SEQ_STEP_END;
+}
+
+/**
+ *  @brief  Run the program until an op waits, at most SEQ_OPS_PER_CYCLE ops.
+ */
+static void SeqRun(uint64_t now)
+{
+	int i, pc, next;
+	float elapsed;
+	const SEQ_OP *op;
+	SEQ_STEP_STATS *step;
+
+	for (i = 0; i < SEQ_OPS_PER_CYCLE && g_run.status.state == SEQ_RUNNING; i++)
+	{
+		pc = g_run.status.pc;
+		if (pc >= g_run.program.count)
+		{
+			next = SEQ_STEP_END;
+		}
+		else
+		{
+			op = &g_run.program.ops[pc];
+			if (g_run.stepStart_ns == 0)
+			{
+				g_run.stepStart_ns = now;
+			}
+
+			next = SeqStep(pc, now);
+			if (next == SEQ_STEP_ABORT)
+			{
+				return;
+			}
+			if (next == SEQ_STEP_WAIT)
+			{
+				if (op->timeout > 0 && now - g_run.stepStart_ns >= op->timeout * 1e9)
+				{
+					SeqAbort(SEQ_ERR_TIMEOUT);
+				}
+				return;
+			}
+
+			elapsed = (now - g_run.stepStart_ns) / 1e9;
+			step = &g_run.steps[pc];
+			step->executions++;
+			step->last = elapsed;
+			if (elapsed > step->max)
+			{
+				step->max = elapsed;
+			}
+			g_run.stepStart_ns = 0;
+			g_run.dirty = 1;
+		}
+
+		if (next == SEQ_STEP_END)
+		{
+			elapsed = (now - g_run.runStart_ns) / 1e9;
+			g_run.status.state = SEQ_DONE;
+			g_run.status.runs++;
+			g_run.status.run_last = elapsed;
+			if (elapsed > g_run.status.run_max)
+			{
+				g_run.status.run_max = elapsed;
+			}
+			g_run.dirty = 1;
+			return;
+		}
+		g_run.status.pc = next;
+	}
+}
+
+/**
+ *  @brief  Take the new program and requests over and run the program. Control thread, before the paths and
+ *          the AxisCmdQueue are executed.
+ */
+void SeqPoll(void)
+{
+	int requests, start = -1;
+	uint64_t now = MonotonicNs();
+
+	if (HandoffCleared(&g_handoff) && g_run.status.state == SEQ_RUNNING)
+	{
+		SeqAbort(SEQ_ERR_REQUEST);
+	}
+
+	//a program the reactor is still copying is taken over in a later cycle
+	if (HandoffTake(&g_handoff))
+	{
+		start = g_uploadStart;
+		if (g_run.status.state == SEQ_RUNNING)
+		{
+			SeqAbort(SEQ_ERR_REQUEST);
+		}
+		memcpy(&g_run.program, &g_upload, sizeof(SEQ_PROGRAM));
+		HandoffRelease(&g_handoff);
+
+		memset(&g_run.status, 0, sizeof(SEQ_STATUS));
+		g_run.status.count = g_run.program.count;
+		SeqResetStats();
+	}
+
+	requests = __atomic_exchange_n(&g_request, 0, __ATOMIC_ACQ_REL);
+	if ((requests & SEQ_REQ_ABORT) && g_run.status.state == SEQ_RUNNING)
+	{
+		SeqAbort(SEQ_ERR_REQUEST);
+	}
+	if (requests & SEQ_REQ_RESET)
+	{
+		SeqResetStats();
+	}
+	if ((start == 1 || (requests & SEQ_REQ_START)) && g_run.status.state != SEQ_RUNNING && g_run.program.count > 0)
+	{
+		g_run.status.state = SEQ_RUNNING;
+		g_run.status.error = SEQ_ERR_NONE;
+		g_run.status.pc = 0;
+		g_run.runStart_ns = now;
+		g_run.stepStart_ns = 0;
+		memset(g_run.loops, 0, sizeof(g_run.loops));
+		g_run.moved = 0;
+		g_run.dirty = 1;
+	}
+
+	if (g_run.status.state == SEQ_RUNNING)
+	{
+		SeqRun(now);
+	}
+
+	//the reactor only holds g_seqLock for a copy, a busy lock is retried in the next cycle
+	if (g_run.dirty && pthread_mutex_trylock(&g_seqLock) == 0)
+	{
+		g_status = g_run.status;
+		memcpy(g_steps, g_run.steps, g_run.status.count * sizeof(SEQ_STEP_STATS));
+		pthread_mutex_unlock(&g_seqLock);
+		g_run.dirty = 0;
+	}
+}
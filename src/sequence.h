@@ -0,0 +1,138 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Sequence programs: a whole machine cycle uploaded once and run step by step by the control thread.
+ *
+ *  A program is uploaded with E_SEQ_LOAD, a SEQ_HEADER followed by its SEQ_OPs, and replaces the loaded
+ *  one, aborting it when it runs. E_SEQ_CTRL (payload SEQ_CTRL) starts or aborts it and is answered with an
+ *  E_SEQ_CTRL frame, a SEQ_STATUS followed by one SEQ_STEP_STATS per op, as of the last control cycle.
+ *
+ *  Every control cycle the program runs from its current op until an op has to wait, at most
+ *  SEQ_OPS_PER_CYCLE ops. Moves go through the AxisCmdQueue like host commands, so the moves of consecutive
+ *  SEQ_MOVE ops start together in the same cycle. The ops:
+ *
+ *      SEQ_END             the program is done
+ *      SEQ_MOVE            queue an axis command: arg the AXIS_CMD opcode, position, distance, duration
+ *      SEQ_WAIT_MOVE       wait until the last move of the axis has run its duration and is in position
+ *      SEQ_WAIT_STAT       wait until (STAT_FLG & arg) == value for the axis
+ *      SEQ_WAIT_ABOVE      wait until NET_CURRENT of the axis >= position
+ *      SEQ_WAIT_BELOW      wait until NET_CURRENT of the axis <= position
+ *      SEQ_DELAY           wait duration seconds
+ *      SEQ_SET_PARAM       AxisSetParam(axis, arg, position)
+ *      SEQ_LOOP            jump to op arg, value times before going on, always for value 0; an endless loop
+ *                          has to wait or delay in it, SeqLoad refuses it otherwise
+ *
+ *  A wait with a timeout aborts the program when it runs out. So do a refused move, a disconnected axis, an
+ *  E_SEQ_CTRL abort and a system stop; the axes complete the move they are in. Host commands still reach the
+ *  axes while a program runs.
+ *
+ *  For every op the status counts its executions and the last and longest time from its start to its end,
+ *  for a wait the time waited; for the program the completed runs and the last and longest run time.
+ */
+
+#ifndef _RUSH_SEQUENCE_H_
+#define _RUSH_SEQUENCE_H_
+
+#include <stdint.h>
+#include "rushEmb.h"
+
+#define SEQ_MAX_OPS				256
+#define SEQ_OPS_PER_CYCLE		64
+
+/* SEQ_OP op */
+#define SEQ_END					0
+#define SEQ_MOVE				1
+#define SEQ_WAIT_MOVE			2
+#define SEQ_WAIT_STAT			3
+#define SEQ_WAIT_ABOVE			4
+#define SEQ_WAIT_BELOW			5
+#define SEQ_DELAY				6
+#define SEQ_SET_PARAM			7
+#define SEQ_LOOP				8
+
+/* SEQ_CTRL command */
+#define SEQ_CTRL_STATUS			0
+#define SEQ_CTRL_START			1
+#define SEQ_CTRL_ABORT			2
+#define SEQ_CTRL_RESET_STATS	3
+
+/* SEQ_STATUS state */
+#define SEQ_IDLE				0
+#define SEQ_RUNNING				1
+#define SEQ_DONE				2
+#define SEQ_ABORTED				3
+
+/* SEQ_STATUS error, why the program was aborted */
+#define SEQ_ERR_NONE			0
+#define SEQ_ERR_REQUEST			1		/* E_SEQ_CTRL abort, new program or system stop */
+#define SEQ_ERR_TIMEOUT			2
+#define SEQ_ERR_MOVE			3		/* AxisExecute dropped the move, or SacPointToPoint refused it */
+#define SEQ_ERR_AXIS			4		/* axis disconnected, or without the shared memory of a wait */
+
+/**
+ * @brief   E_SEQ_LOAD header, followed by count SEQ_OPs.
+ */
+typedef struct seq_header
+{
+	int32_t				count;				/**< 0 unloads the program */
+	int32_t				start;				/**< Start the program right away */
+} SEQ_HEADER;
+
+/**
+ * @brief   One op of a program, see the table above for the fields each op uses.
+ */
+typedef struct seq_op
+{
+	int32_t				op;
+	int32_t				axis;
+	int32_t				arg;
+	uint32_t			value;
+	double				position;
+	float				distance;
+	float				duration;
+	float				timeout;			/**< Waits, seconds, 0 without */
+} SEQ_OP;
+
+/**
+ * @brief   E_SEQ_CTRL request.
+ */
+typedef struct seq_ctrl
+{
+	int32_t				command;			/**< SEQ_CTRL_STATUS ... SEQ_CTRL_RESET_STATS */
+} SEQ_CTRL;
+
+/**
+ * @brief   E_SEQ_CTRL reply header, followed by count SEQ_STEP_STATS.
+ */
+typedef struct seq_status
+{
+	int32_t				state;				/**< SEQ_IDLE ... SEQ_ABORTED */
+	int32_t				error;				/**< SEQ_ERR_NONE ... SEQ_ERR_AXIS */
+	int32_t				pc;					/**< Current op, or the op that aborted */
+	int32_t				count;
+	uint32_t			runs;				/**< Completed runs since the last reset */
+	float				run_last;			/**< Seconds */
+	float				run_max;
+} SEQ_STATUS;
+
+typedef struct seq_step_stats
+{
+	uint32_t			executions;
+	float				last;				/**< Seconds from the start to the end of the op */
+	float				max;
+} SEQ_STEP_STATS;
+
+int SeqLoad(const SEQ_HEADER *header, const SEQ_OP *ops);
+int SeqControl(const SEQ_CTRL *ctrl, SEQ_STATUS *status, SEQ_STEP_STATS *steps);
+void SeqClearAll(void);
+void SeqPoll(void);
+
+#endif
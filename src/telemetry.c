@@ -0,0 +1,602 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Encode-once telemetry fan-out, see telemetry.h.
+ *
+ *  All functions run on the dyad update thread.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "rushEmb.h"
+#include "telemetry.h"
+#include "monotonic.h"
+
+#define MEMBER_SIZE(type, member)	sizeof(((type*)0)->member)
+
+/*
+ * Sections of the status reply, in the order they are put in the frame.
+ * sys_case is appended after these on every frame.
+ */
+static TELEM_CHANNEL g_channels[] =
+{
+	{ E_STAT_FLG,		offsetof(SHMEM_DATA, STAT_FLG),		MEMBER_SIZE(SHMEM_DATA, STAT_FLG),		TELEM_UINT32,	TELEM_ON_CHANGE,	SHM_CH_STAT_FLG,	OLD_STAT_FLG },
+	{ E_VC_POS,			offsetof(SHMEM_DATA, VC_POS),		MEMBER_SIZE(SHMEM_DATA, VC_POS),		TELEM_FLOAT,	TELEM_ON_CHANGE,	SHM_CH_VC_POS,		LAST_VC_POS },
+	{ E_NET_CURRENT,	offsetof(SHMEM_DATA, NET_CURRENT),	MEMBER_SIZE(SHMEM_DATA, NET_CURRENT),	TELEM_FLOAT,	TELEM_ON_CHANGE,	SHM_CH_NET_CURRENT,	OLD_NET_CURRENT },
+};
+
+#define TELEM_CHANNEL_COUNT		(int)(sizeof(g_channels) / sizeof(g_channels[0]))
+
+/* "786", flag and size in front of every section, see rushMakeBuffer */
+#define TELEM_SECTION_HEADER	8
+
+/* Largest delta that is still smaller than a snapshot */
+#define TELEM_DELTA_ENTRY		6
+#define TELEM_MAX_DELTA			((TELEM_STATE_WORDS * 4 - 6) / TELEM_DELTA_ENTRY)
+
+static TELEM_FRAME		g_frame;				// Frame of the current cycle, encoded on first use
+static unsigned int		g_cycle = 1;
+static unsigned int		g_encodeCount = 0;
+static unsigned int		g_localGen[TELEM_MAX_CHANNELS];	// Generations derived by the server for an older UDSX
+
+/* Versioned state for delta sync */
+static uint32_t			g_state[TELEM_STATE_WORDS];
+static unsigned int		g_lastChange[TELEM_STATE_WORDS];	// Version in which each word last changed
+static unsigned int		g_version = 1;
+static TELEM_SESSION	g_sessions[TELEM_MAX_SESSIONS];
+static int				g_fastWake = 0;
+
+
+/**
+ *  @brief  Whether the UDSX behind shm bumps channel_gen itself.
+ */
+static int TelemProducerGenerations(const SHMEM_DATA *shm)
+{
+	return shm == pShmem_data &&
+		   g_sharedMemorySize >= sizeof(SHMEM_DATA) &&
+		   shm->gen_magic == SHM_GEN_MAGIC;
+}
+
+static long long TelemNow_ms(void)
+{
+	return MonotonicNs() / 1000000;
+}
+
+/**
+ *  @brief  Copy one channel out of the shared memory.
+ *
+ *  @param[out] gen     Generation the copy belongs to, when the UDSX keeps them.
+ *  @return 0 when every attempt overlapped a write of the UDSX; raw is then torn and must not be published.
+ */
+static int TelemReadChannel(const TELEM_CHANNEL *channel, const SHMEM_DATA *shm, void *raw, unsigned int *gen)
+{
+	const char *src = (const char*)shm + channel->offset;
+
+	if (!TelemProducerGenerations(shm))
+	{
+		memcpy(raw, src, channel->size);
+		return 1;
+	}
+	return ShmReadChannel(shm, channel->gen, raw, src, channel->size, gen);
+}
+
+/**
+ *  @brief  Apply the channel filter to a fresh copy and update the published copy.
+ *
+ *  @return 1 when the published copy was refreshed.
+ */
+static int TelemFilterChannel(TELEM_CHANNEL *channel, const void *raw, long long now)
+{
+	TELEM_FILTER *filter = &channel->filter;
+	int count = channel->size / sizeof(uint32_t);
+	int i, published = 0;
+	float value, last, band;
+
+	if (now - filter->lastPublish_ms < filter->minInterval_ms)
+	{
+		return 0;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (channel->type == TELEM_FLOAT)
+		{
+			value = ((const float*)raw)[i];
+			last = ((float*)channel->last)[i];
+			band = filter->relDeadband[i] * fabsf(last);
+			if (band < filter->absDeadband[i])
+			{
+				band = filter->absDeadband[i];
+			}
+			if (value == last || (fabsf(value - last) <= band && !isnan(value) && !isnan(last)))
+			{
+				continue;
+			}
+			((float*)channel->last)[i] = value;
+		}
+		else
+		{
+			if (((const uint32_t*)raw)[i] == ((uint32_t*)channel->last)[i])
+			{
+				continue;
+			}
+			((uint32_t*)channel->last)[i] = ((const uint32_t*)raw)[i];
+		}
+		published = 1;
+	}
+
+	if (!published && filter->maxInterval_ms > 0 && now - filter->lastPublish_ms >= filter->maxInterval_ms)
+	{
+		/* heartbeat: the true values, including changes held back by the deadband */
+		memcpy(channel->last, raw, channel->size);
+		published = 1;
+	}
+
+	if (published)
+	{
+		filter->lastPublish_ms = now;
+	}
+	return published;
+}
+
+/**
+ *  @brief  Whether a channel can be left as it is: the UDSX has not written it since the filter last saw it in
+ *          full, and no heartbeat is due.
+ */
+static int TelemChannelSettled(const TELEM_CHANNEL *channel, const SHMEM_DATA *shm, long long now)
+{
+	const TELEM_FILTER *filter = &channel->filter;
+
+	return filter->settled &&
+		   TelemProducerGenerations(shm) &&
+		   ShmLoadGen(shm, channel->gen) == filter->settledGen &&
+		   !(filter->maxInterval_ms > 0 && now - filter->lastPublish_ms >= filter->maxInterval_ms);
+}
+
+/**
+ *  @brief  Append one channel to a frame.
+ *
+ *  @return Generation of the published copy that was put in the frame.
+ */
+static unsigned int TelemEncodeChannel(TELEM_FRAME *frame, int ch, const SHMEM_DATA *shm, long long now)
+{
+	TELEM_CHANNEL *channel = &g_channels[ch];
+	TELEM_FILTER *filter = &channel->filter;
+	uint32_t raw[TELEM_MAX_ELEMENTS];
+	unsigned int gen = 0;
+	int held;
+
+	/* one filter pass per channel and cycle, shared by all sessions; a torn copy keeps the last published one */
+	if (!TelemChannelSettled(channel, shm, now) && TelemReadChannel(channel, shm, raw, &gen))
+	{
+		held = now - filter->lastPublish_ms < filter->minInterval_ms;
+		if (TelemFilterChannel(channel, raw, now))
+		{
+			g_localGen[ch]++;
+		}
+		/* a copy held back by minInterval has to be filtered again */
+		filter->settled = !held && TelemProducerGenerations(shm);
+		filter->settledGen = gen;
+	}
+
+	rushMakeBuffer(frame->data, channel->last, &frame->size, channel->size, channel->flag);
+	return g_localGen[ch];
+}
+
+/**
+ *  @brief  Fold the channels of a freshly encoded frame into the versioned state and add the E_SNAPSHOT section.
+ */
+static void TelemUpdateState(TELEM_FRAME *frame, char sysCase)
+{
+	uint32_t words[TELEM_STATE_WORDS];
+	char snapshot[sizeof(uint32_t) + sizeof(words)];
+	int ch, w, word = 0, changed = 0;
+
+	memcpy(words, g_state, sizeof(words));
+
+	for (ch = 0; ch < TELEM_CHANNEL_COUNT; ch++)
+	{
+		if (frame->sectionLen[ch] > 0)
+		{
+			memcpy(&words[word], frame->data + frame->sectionOff[ch] + TELEM_SECTION_HEADER, g_channels[ch].size);
+		}
+		word += g_channels[ch].size / sizeof(uint32_t);
+	}
+	words[word] = (unsigned char)sysCase;
+
+	for (w = 0; w < TELEM_STATE_WORDS; w++)
+	{
+		if (words[w] != g_state[w])
+		{
+			if (!changed)
+			{
+				g_version++;
+				changed = 1;
+			}
+			g_state[w] = words[w];
+			g_lastChange[w] = g_version;
+		}
+	}
+
+	frame->version = g_version;
+
+	memcpy(snapshot, &frame->version, sizeof(uint32_t));
+	memcpy(snapshot + sizeof(uint32_t), g_state, sizeof(g_state));
+	frame->snapshotOff = frame->size;
+	rushMakeBuffer(frame->data, snapshot, &frame->size, sizeof(snapshot), E_SNAPSHOT);
+	frame->snapshotLen = frame->size - frame->snapshotOff;
+}
+
+/**
+ *  @brief  Encode the status reply of one cycle into a frame.
+ *
+ *  @param[out] frame       Frame to fill.
+ *  @param[in]  shm         Shared memory snapshot to encode, NULL only encodes sys_case and the nodes.
+ *  @param[in]  sysCase     Current system state.
+ */
+static void TelemEncode(TELEM_FRAME *frame, const SHMEM_DATA *shm, char sysCase)
+{
+	long long now = TelemNow_ms();
+	NODE_STATUS node;
+	int ch, n;
+
+	frame->size = 0;
+
+	for (ch = 0; ch < TELEM_CHANNEL_COUNT; ch++)
+	{
+		frame->sectionOff[ch] = frame->size;
+		if (shm)
+		{
+			frame->gen[ch] = TelemEncodeChannel(frame, ch, shm, now);
+		}
+		frame->sectionLen[ch] = frame->size - frame->sectionOff[ch];
+	}
+
+	frame->sysCaseOff = frame->size;
+	rushMakeBuffer(frame->data, &sysCase, &frame->size, sizeof(char) * 1, E_SYS_CASE);
+
+	frame->nodesOff = frame->size;
+	for (n = 0; NodeCount > 1 && n < NodeCount; n++)
+	{
+		if (NodeReadStatus(n, &node))
+		{
+			rushMakeBuffer(frame->data, (char*)&node, &frame->size, sizeof(node), E_NODE_STAT);
+		}
+	}
+	frame->nodesLen = frame->size - frame->nodesOff;
+
+	TelemUpdateState(frame, sysCase);
+	g_encodeCount++;
+}
+
+void TelemInit(void)
+{
+	int ch;
+
+	memset(&g_frame, 0, sizeof(g_frame));
+	memset(g_sessions, 0, sizeof(g_sessions));
+	memset(g_localGen, 0, sizeof(g_localGen));
+	memset(g_state, 0, sizeof(g_state));
+	memset(g_lastChange, 0, sizeof(g_lastChange));
+	g_version = 1;
+	g_cycle = 1;
+	g_encodeCount = 0;
+
+	for (ch = 0; ch < TELEM_CHANNEL_COUNT; ch++)
+	{
+		memset(g_channels[ch].last, 0, g_channels[ch].size);
+		memset(&g_channels[ch].filter, 0, sizeof(TELEM_FILTER));
+		g_channels[ch].filter.maxInterval_ms = TELEM_HEARTBEAT_MS;
+	}
+}
+
+/**
+ *  @brief  Start a new reactor cycle; the next reply encodes a fresh frame.
+ */
+void TelemBeginCycle(void)
+{
+	g_cycle++;
+}
+
+/**
+ *  @brief  Get the frame of the current cycle, encoding it on first use.
+ *
+ *  dyad copies every write into the stream buffer, so the frame is free again as soon as TelemSend
+ *  returns and the next cycle encodes over it.
+ */
+static TELEM_FRAME* TelemCurrentFrame(void)
+{
+	if (g_frame.cycle != g_cycle)
+	{
+		TelemEncode(&g_frame, pShmem_data, sys_case);
+		g_frame.cycle = g_cycle;
+	}
+	return &g_frame;
+}
+
+/**
+ *  @brief  Register a client as telemetry observer.
+ *
+ *  @return Session to pass as listener udata, NULL when all sessions are in use.
+ */
+TELEM_SESSION* TelemAttach(void *sink, TELEM_WRITE write)
+{
+	int i;
+
+	for (i = 0; i < TELEM_MAX_SESSIONS; i++)
+	{
+		if (!g_sessions[i].active)
+		{
+			g_sessions[i].active = 1;
+			g_sessions[i].sink = sink;
+			g_sessions[i].write = write;
+			/* nothing sent yet: the first reply carries every channel */
+			memset(g_sessions[i].lastGen, 0xFF, sizeof(g_sessions[i].lastGen));
+			return &g_sessions[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ *  @brief  Wake the reactor every TELEM_PUSH_LATENCY_MS while a client is subscribed to a pushed stream, so
+ *          TraceDrain and MoveEventDrain keep up without waiting for the next request of some client.
+ */
+static void TelemUpdateWake(void)
+{
+	int fastWake = TelemSubscriberCount(TELEM_SUB_PUSHED) > 0;
+
+	if (fastWake != g_fastWake)
+	{
+		dyad_setUpdateTimeout(fastWake ? TELEM_PUSH_LATENCY_MS / 1000.0 : 1);
+		g_fastWake = fastWake;
+	}
+}
+
+void TelemDetach(TELEM_SESSION *session)
+{
+	if (session)
+	{
+		memset(session, 0, sizeof(*session));
+		TelemUpdateWake();
+	}
+}
+
+/**
+ *  @brief  Reply to a delta sync session: the delta since its acknowledged version, or a snapshot.
+ */
+static void TelemSendSync(TELEM_SESSION *session, TELEM_FRAME *frame)
+{
+	char delta[10 + TELEM_MAX_DELTA * TELEM_DELTA_ENTRY];
+	char encoded[sizeof(delta) + TELEM_SECTION_HEADER];
+	const char *state = frame->data + frame->snapshotOff + TELEM_SECTION_HEADER + sizeof(uint32_t);
+	unsigned int base = session->ackVersion;
+	unsigned short count = 0, index;
+	int w, size = 10, pointer = 0;
+
+	if (base != 0 && base <= frame->version && frame->version - base <= TELEM_SYNC_MAX_GAP)
+	{
+		for (w = 0; w < TELEM_STATE_WORDS; w++)
+		{
+			if (g_lastChange[w] > base)
+			{
+				if (count == TELEM_MAX_DELTA)
+				{
+					break;
+				}
+				index = w;
+				memcpy(delta + size, &index, sizeof(index));
+				memcpy(delta + size + 2, state + w * sizeof(uint32_t), sizeof(uint32_t));
+				size += TELEM_DELTA_ENTRY;
+				count++;
+			}
+		}
+
+		if (w == TELEM_STATE_WORDS)
+		{
+			memcpy(delta, &frame->version, sizeof(uint32_t));
+			memcpy(delta + 4, &base, sizeof(uint32_t));
+			memcpy(delta + 8, &count, sizeof(count));
+			rushMakeBuffer(encoded, delta, &pointer, size, E_DELTA);
+			session->write(session->sink, encoded, pointer);
+			return;
+		}
+	}
+
+	session->write(session->sink, frame->data + frame->snapshotOff, frame->snapshotLen);
+}
+
+/**
+ *  @brief  Write the status reply of the current cycle to a session.
+ *
+ *  TELEM_ON_CHANGE sections are only written when their generation differs from the one last sent to this session.
+ */
+void TelemSend(TELEM_SESSION *session)
+{
+	TELEM_FRAME *frame;
+	int ch;
+
+	if (session == NULL || !session->active)
+	{
+		return;
+	}
+
+	frame = TelemCurrentFrame();
+
+	if (session->syncMode)
+	{
+		TelemSendSync(session, frame);
+		if (frame->nodesLen > 0)
+		{
+			session->write(session->sink, frame->data + frame->nodesOff, frame->nodesLen);
+		}
+		return;
+	}
+
+	for (ch = 0; ch < TELEM_CHANNEL_COUNT; ch++)
+	{
+		if (frame->sectionLen[ch] == 0)
+		{
+			continue;
+		}
+		if (g_channels[ch].mode == TELEM_ON_CHANGE && session->lastGen[ch] == frame->gen[ch])
+		{
+			continue;
+		}
+		session->lastGen[ch] = frame->gen[ch];
+		session->write(session->sink, frame->data + frame->sectionOff[ch], frame->sectionLen[ch]);
+	}
+	session->write(session->sink, frame->data + frame->sysCaseOff, frame->snapshotOff - frame->sysCaseOff);
+}
+
+/**
+ *  @brief  Queue one reply for a session that sent frames this cycle, however many it sent.
+ */
+void TelemRequestReply(TELEM_SESSION *session)
+{
+	if (session && session->active)
+	{
+		session->replyPending = 1;
+	}
+}
+
+/**
+ *  @brief  Answer every session that requested a reply, at the end of the reactor cycle.
+ */
+void TelemFlush(void)
+{
+	int i;
+
+	for (i = 0; i < TELEM_MAX_SESSIONS; i++)
+	{
+		if (g_sessions[i].active && g_sessions[i].replyPending)
+		{
+			g_sessions[i].replyPending = 0;
+			TelemSend(&g_sessions[i]);
+		}
+	}
+}
+
+/**
+ *  @brief  E_SYNC_ACK from a client: switch the session to delta sync and record the applied version.
+ */
+void TelemAck(TELEM_SESSION *session, unsigned int version)
+{
+	if (session && session->active)
+	{
+		session->syncMode = 1;
+		session->ackVersion = version;
+	}
+}
+
+/**
+ *  @brief  E_TELEM_FILTER from a client: configure the publish filter of a channel.
+ *
+ *  @return 1 when applied, 0 for an unknown channel or element.
+ */
+int TelemSetFilter(const TELEM_FILTER_CFG *cfg)
+{
+	TELEM_FILTER *filter;
+	int ch, i, count;
+
+	for (ch = 0; ch < TELEM_CHANNEL_COUNT; ch++)
+	{
+		if (g_channels[ch].flag == cfg->channel)
+		{
+			break;
+		}
+	}
+
+	if (ch == TELEM_CHANNEL_COUNT)
+	{
+		return 0;
+	}
+
+	count = g_channels[ch].size / sizeof(uint32_t);
+	if (cfg->element < -1 || cfg->element >= count || cfg->absDeadband < 0 || cfg->relDeadband < 0 ||
+		cfg->minInterval_ms < 0 || cfg->maxInterval_ms < 0)
+	{
+		return 0;
+	}
+
+	filter = &g_channels[ch].filter;
+	for (i = 0; i < count; i++)
+	{
+		if (cfg->element == -1 || cfg->element == i)
+		{
+			filter->absDeadband[i] = cfg->absDeadband;
+			filter->relDeadband[i] = cfg->relDeadband;
+		}
+	}
+	filter->minInterval_ms = cfg->minInterval_ms;
+	filter->maxInterval_ms = cfg->maxInterval_ms;
+	filter->settled = 0;
+	return 1;
+}
+
+void TelemSubscribe(TELEM_SESSION *session, int mask, int enable)
+{
+	if (session && session->active)
+	{
+		if (enable)
+		{
+			session->subscriptions |= mask;
+		}
+		else
+		{
+			session->subscriptions &= ~mask;
+		}
+		TelemUpdateWake();
+	}
+}
+
+int TelemSubscriberCount(int mask)
+{
+	int i, count = 0;
+
+	for (i = 0; i < TELEM_MAX_SESSIONS; i++)
+	{
+		if (g_sessions[i].active && (g_sessions[i].subscriptions & mask))
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+/**
+ *  @brief  Push an encoded frame to every session subscribed to mask.
+ */
+void TelemBroadcast(int mask, const void *data, int size)
+{
+	int i;
+
+	for (i = 0; i < TELEM_MAX_SESSIONS; i++)
+	{
+		if (g_sessions[i].active && (g_sessions[i].subscriptions & mask))
+		{
+			g_sessions[i].write(g_sessions[i].sink, data, size);
+		}
+	}
+}
+
+void TelemStreamWrite(void *sink, const void *data, int size)
+{
+	dyad_write((dyad_Stream*)sink, data, size);
+}
+
+unsigned int TelemEncodeCount(void)
+{
+	return g_encodeCount;
+}
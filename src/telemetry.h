@@ -0,0 +1,168 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Telemetry frames encoded once per reactor cycle and shared by every connected client.
+ *
+ *  The status reply (STAT_FLG, VC_POS, NET_CURRENT, sys_case) used to be re-encoded from pShmem_data
+ *  for every client on every request. The reply is now encoded into one frame the first time it is needed
+ *  in a cycle; every other session replying in the same cycle reuses it.
+ *
+ *  With more than one node the reply also carries an E_NODE_STAT section (NODE_STATUS) for every node after
+ *  sys_case, so one connection observes the whole cell. Delta sync sessions get them after the delta.
+ *
+ *  Each frame carries the generation of every channel. A session remembers the generations it has
+ *  sent, so a change is delivered to every client, not only to the first one replied to after it.
+ *
+ *  Each channel is filtered before it is encoded. A float element is only republished when it moved by
+ *  more than its absolute deadband, or by more than its relative deadband times the last published value.
+ *  minInterval_ms limits how often a channel is republished, maxInterval_ms forces a refresh of the whole
+ *  channel as a heartbeat. The defaults publish every change and refresh once per second.
+ *
+ *  Delta sync: a client that sends E_SYNC_ACK switches its session from the legacy reply to versioned
+ *  state sync. The state is STAT_FLG[10], VC_POS[20], NET_CURRENT[10] and sys_case, as 32-bit words.
+ *  The version only advances when a word changes. Replies are then
+ *
+ *      E_SNAPSHOT  uint32 version, uint32 word[TELEM_STATE_WORDS]
+ *      E_DELTA     uint32 version, uint32 baseVersion, uint16 count, count * { uint16 word, uint32 value }
+ *
+ *  A delta holds every word changed after the version the client last acknowledged, so it can be applied
+ *  to any state the client received since then. The client acknowledges each applied version with
+ *  E_SYNC_ACK (uint32 version, 0 to request a snapshot). A snapshot is sent on join, when the client's
+ *  version is unknown, or when the delta would be larger than a snapshot.
+ */
+
+#ifndef _RUSH_TELEMETRY_H_
+#define _RUSH_TELEMETRY_H_
+
+#include "dyad.h"
+#include "node.h"
+
+#define TELEM_FRAME_SIZE		(512 + NODE_MAX * (sizeof(NODE_STATUS) + 8))	/* legacy reply, E_SNAPSHOT and the nodes */
+#define TELEM_MAX_SESSIONS		64
+#define TELEM_MAX_CHANNELS		8
+#define TELEM_MAX_ELEMENTS		20		/* elements of the largest channel */
+#define TELEM_HEARTBEAT_MS		1000	/* default maxInterval_ms */
+#define TELEM_STATE_WORDS		41		/* channel words plus sys_case */
+#define TELEM_SYNC_MAX_GAP		100000	/* versions; older acknowledgements get a snapshot */
+
+/* Session subscriptions to pushed frames */
+#define TELEM_SUB_TRACE			0x01
+#define TELEM_SUB_MOVE			0x02		/* moveEvent.h */
+#define TELEM_SUB_PUSHED		(TELEM_SUB_TRACE | TELEM_SUB_MOVE)
+
+/* Reactor wake-up while a pushed stream has subscribers, the select timeout stays at 1 s otherwise */
+#define TELEM_PUSH_LATENCY_MS	2
+
+/* Channel publish modes */
+#define TELEM_ALWAYS			0
+#define TELEM_ON_CHANGE			1
+
+/* Channel element types */
+#define TELEM_FLOAT				0
+#define TELEM_UINT32			1
+
+/**
+ * @brief   Writes an encoded frame to a session sink, dyad_write for network clients.
+ */
+typedef void (*TELEM_WRITE)(void *sink, const void *data, int size);
+
+/**
+ * @brief   Publish filter of one channel.
+ */
+typedef struct telem_filter
+{
+	float				absDeadband[TELEM_MAX_ELEMENTS];	/**< Per element, TELEM_FLOAT channels only */
+	float				relDeadband[TELEM_MAX_ELEMENTS];	/**< Fraction of the last published value */
+	int					minInterval_ms;	/**< 0 publishes every cycle */
+	int					maxInterval_ms;	/**< Heartbeat refresh, 0 disables it */
+	long long			lastPublish_ms;
+	int					settled;		/**< raw of settledGen went through the filter in full */
+	unsigned int		settledGen;
+} TELEM_FILTER;
+
+/**
+ * @brief   E_TELEM_FILTER payload, sets the filter of one element or of a whole channel.
+ */
+typedef struct telem_filter_cfg
+{
+	int					channel;		/**< E_STAT_FLG, E_VC_POS or E_NET_CURRENT */
+	int					element;		/**< Index in the channel, -1 for every element */
+	float				absDeadband;
+	float				relDeadband;
+	int					minInterval_ms;
+	int					maxInterval_ms;
+} TELEM_FILTER_CFG;
+
+/**
+ * @brief   One section of the status reply, read from the shared memory.
+ */
+typedef struct telem_channel
+{
+	char				flag;			/**< E_* flag put in the frame header */
+	int					offset;			/**< Byte offset of the array inside SHMEM_DATA */
+	int					size;			/**< Size of the array in bytes */
+	int					type;			/**< TELEM_FLOAT or TELEM_UINT32 elements */
+	int					mode;			/**< TELEM_ALWAYS or TELEM_ON_CHANGE */
+	int					gen;			/**< SHM_CH_* generation counter of the channel */
+	void*				last;			/**< Last published copy, this is what the frames carry */
+	TELEM_FILTER		filter;
+} TELEM_CHANNEL;
+
+/**
+ * @brief   Encoded status reply, shared read-only by all sessions of a cycle.
+ */
+typedef struct telem_frame
+{
+	unsigned int		cycle;			/**< Reactor cycle the frame was encoded in */
+	int					size;
+	int					sectionOff[TELEM_MAX_CHANNELS];
+	int					sectionLen[TELEM_MAX_CHANNELS];	/**< 0 when the channel is not in the frame */
+	unsigned int		gen[TELEM_MAX_CHANNELS];		/**< Channel generations the sections were read at */
+	int					sysCaseOff;
+	int					nodesOff;		/**< E_NODE_STAT sections, one per node with more than one node */
+	int					nodesLen;
+	int					snapshotOff;	/**< E_SNAPSHOT section, only sent to delta sync sessions */
+	int					snapshotLen;
+	unsigned int		version;		/**< State version of this frame */
+	char				data[TELEM_FRAME_SIZE];
+} TELEM_FRAME;
+
+/**
+ * @brief   Connected client observing the telemetry.
+ */
+typedef struct telem_session
+{
+	int					active;
+	void*				sink;			/**< dyad_Stream of the client */
+	TELEM_WRITE			write;
+	int					subscriptions;	/**< TELEM_SUB_* frames pushed to this client */
+	int					replyPending;	/**< Sent a frame this cycle, answered once by TelemFlush */
+	int					syncMode;		/**< Set by the first E_SYNC_ACK */
+	unsigned int		ackVersion;		/**< Last state version acknowledged by the client, 0 for none */
+	unsigned int		lastGen[TELEM_MAX_CHANNELS];	/**< Channel generations last sent to this client */
+} TELEM_SESSION;
+
+void TelemInit(void);
+void TelemBeginCycle(void);
+TELEM_SESSION* TelemAttach(void *sink, TELEM_WRITE write);
+void TelemDetach(TELEM_SESSION *session);
+void TelemSend(TELEM_SESSION *session);
+void TelemRequestReply(TELEM_SESSION *session);
+void TelemFlush(void);
+void TelemAck(TELEM_SESSION *session, unsigned int version);
+int TelemSetFilter(const TELEM_FILTER_CFG *cfg);
+void TelemSubscribe(TELEM_SESSION *session, int mask, int enable);
+int TelemSubscriberCount(int mask);
+void TelemBroadcast(int mask, const void *data, int size);
+void TelemStreamWrite(void *sink, const void *data, int size);
+unsigned int TelemEncodeCount(void);
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Drains the UDSX trace ring on the dyad update thread, see traceRing.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "rushEmb.h"
+#include "telemetry.h"
+#include "trace.h"
+
+#define TRACE_ERR_FAILED_TO_CREATE_SHM		USR_ERROR(110)
+#define TRACE_ERR_FAILED_TO_RESIZE_SHM		USR_ERROR(111)
+#define TRACE_ERR_FAILED_TO_MAP_SHM			USR_ERROR(112)
+
+typedef struct trace_bulk
+{
+	TRACE_BULK_HEADER	header;
+	TRACE_SAMPLE		samples[TRACE_BULK_SAMPLES];
+} TRACE_BULK;
+
+static int			g_traceDescriptor = -1;
+static TRACE_RING*	g_traceRing = NULL;
+static uint32_t		g_lastOverruns = 0;
+
+static TRACE_BULK	g_bulk;
+static char			g_bulkFrame[sizeof(TRACE_BULK) + 8];
+
+
+/**
+ *  @brief  Create and map the trace ring. Must run before the UDSX is started.
+ */
+NYCE_STATUS TraceInit(void)
+{
+	NYCE_STATUS retVal = NYCE_OK;
+
+	g_traceDescriptor = shm_open(TRACE_SHM_NAME, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	if (g_traceDescriptor == -1)
+	{
+		return TRACE_ERR_FAILED_TO_CREATE_SHM;
+	}
+
+	if (ftruncate(g_traceDescriptor, sizeof(*g_traceRing)) != 0)
+	{
+		retVal = TRACE_ERR_FAILED_TO_RESIZE_SHM;
+	}
+	else
+	{
+		g_traceRing = mmap(NULL, sizeof(*g_traceRing), PROT_READ | PROT_WRITE, MAP_SHARED, g_traceDescriptor, 0);
+		if (g_traceRing == MAP_FAILED)
+		{
+			g_traceRing = NULL;
+			retVal = TRACE_ERR_FAILED_TO_MAP_SHM;
+		}
+		else
+		{
+			memset(g_traceRing, 0, sizeof(*g_traceRing));
+			g_traceRing->capacity = TRACE_RING_CAPACITY;
+			__atomic_store_n(&g_traceRing->magic, TRACE_RING_MAGIC, __ATOMIC_RELEASE);
+			g_lastOverruns = 0;
+		}
+	}
+
+	if (NyceError(retVal))
+	{
+		TraceTerm();
+	}
+	return retVal;
+}
+
+void TraceTerm(void)
+{
+	if (g_traceRing)
+	{
+		(void)munmap(g_traceRing, sizeof(*g_traceRing));
+		g_traceRing = NULL;
+	}
+
+	if (g_traceDescriptor != -1)
+	{
+		(void)close(g_traceDescriptor);
+		g_traceDescriptor = -1;
+		(void)shm_unlink(TRACE_SHM_NAME);
+	}
+}
+
+/**
+ *  @brief  Move all queued samples to the clients subscribed to E_TRACE, in frames of TRACE_BULK_SAMPLES.
+ *
+ *  Samples are consumed even when nobody is subscribed, so the UDSX only overruns when this thread stalls.
+ */
+void TraceDrain(void)
+{
+	int count, pointer, drained = 0;
+	uint32_t overruns;
+
+	if (g_traceRing == NULL)
+	{
+		return;
+	}
+
+	overruns = __atomic_load_n(&g_traceRing->overruns, __ATOMIC_RELAXED);
+
+	do
+	{
+		count = TraceRingPop(g_traceRing, g_bulk.samples, TRACE_BULK_SAMPLES);
+		drained += count;
+
+		if (count > 0 && TelemSubscriberCount(TELEM_SUB_TRACE) > 0)
+		{
+			g_bulk.header.count = count;
+			g_bulk.header.overruns = overruns;
+
+			pointer = 0;
+			rushMakeBuffer(g_bulkFrame, (char*)&g_bulk, &pointer,
+						   sizeof(TRACE_BULK_HEADER) + count * sizeof(TRACE_SAMPLE), E_TRACE);
+			TelemBroadcast(TELEM_SUB_TRACE, g_bulkFrame, pointer);
+		}
+	} while (count == TRACE_BULK_SAMPLES && drained < TRACE_RING_CAPACITY);
+
+	if (overruns != g_lastOverruns)
+	{
+		logging(100,(float)(overruns - g_lastOverruns),"trace ring overrun","TraceDrain");  ////////////////log
+		g_lastOverruns = overruns;
+	}
+}
@@ -0,0 +1,27 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb
+ */
+
+/**
+ *  @file
+ *  @brief  Server side of the UDSX trace ring: maps the region and streams samples to subscribed clients.
+ */
+
+#ifndef _RUSH_TRACE_H_
+#define _RUSH_TRACE_H_
+
+#include <nycedefs.h>
+#include "traceRing.h"
+
+#define TRACE_BULK_SAMPLES		64		/* samples per E_TRACE frame */
+
+NYCE_STATUS TraceInit(void);
+void TraceTerm(void);
+void TraceDrain(void);
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ *  Exis Tech
+ *
+ *	Company name : Exis Tech Sdn. bhd.
+ *
+ *  Product Name:   NYCe4000
+ *  Component Name: rushEmb and librushUDSX.so
+ */
+
+/**
+ *  @file
+ *  @brief  Trace ring shared between the UDSX (producer) and rushEmb (consumer).
+ *
+ *  This is the second of the SHMEM_AREA shared memory regions. SHMEM_DATA only holds the latest
+ *  snapshot; the UDSX additionally pushes one timestamped sample per controller cycle into this
+ *  single-producer/single-consumer ring so nothing is lost between two reads of the server.
+ *
+ *  rushEmb creates and initializes the region before the UDSX is started; the UDSX only opens it.
+ *  When the ring is full the UDSX drops the sample and counts it in overruns, it never waits.
+ */
+
+#ifndef _RUSH_TRACE_RING_H_
+#define _RUSH_TRACE_RING_H_
+
+#include <stdint.h>
+
+#define TRACE_SHM_NAME			"rushtrace"
+#define TRACE_RING_MAGIC		0x54524331		/* "TRC1" */
+#define TRACE_RING_CAPACITY		4096			/* samples, must be a power of two */
+
+/**
+ * @brief   One controller cycle as seen by the UDSX.
+ */
+typedef struct trace_sample
+{
+	uint64_t			timestamp_ns;		/**< CLOCK_MONOTONIC of the UDSX cycle */
+	uint32_t			cycle;				/**< UDSX cycle counter, consecutive samples differ by one */
+	uint32_t			STAT_FLG[10];
+	float				VC_POS[20];
+	float				NET_CURRENT[10];
+	uint32_t			reserved;
+} TRACE_SAMPLE;
+
+typedef struct trace_ring
+{
+	uint32_t			magic;
+	uint32_t			capacity;
+	uint32_t			pad0[14];
+	uint32_t			head;				/**< Next sample to write, only written by the UDSX */
+	uint32_t			overruns;			/**< Samples dropped by the UDSX because the ring was full */
+	uint32_t			pad1[14];
+	uint32_t			tail;				/**< Next sample to read, only written by rushEmb */
+	uint32_t			pad2[15];
+	TRACE_SAMPLE		samples[TRACE_RING_CAPACITY];
+} TRACE_RING;
+
+/**
+ * @brief   Header of an E_TRACE frame, followed by count TRACE_SAMPLEs.
+ */
+typedef struct trace_bulk_header
+{
+	uint32_t			count;
+	uint32_t			overruns;			/**< Total samples dropped by the UDSX so far */
+} TRACE_BULK_HEADER;
+
+/**
+ *  @brief  Producer side, called by the UDSX once per cycle.
+ *
+ *  @return 1 when the sample was queued, 0 when it was dropped.
+ */
+static inline int TraceRingPush(TRACE_RING *ring, const TRACE_SAMPLE *sample)
+{
+	uint32_t head = ring->head;
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail >= TRACE_RING_CAPACITY)
+	{
+		__atomic_store_n(&ring->overruns, ring->overruns + 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	ring->samples[head & (TRACE_RING_CAPACITY - 1)] = *sample;
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/**
+ *  @brief  Consumer side, called by the server.
+ *
+ *  @return Number of samples copied to out.
+ */
+static inline int TraceRingPop(TRACE_RING *ring, TRACE_SAMPLE *out, int max)
+{
+	uint32_t tail = ring->tail;
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint32_t count = head - tail;
+	uint32_t i;
+
+	if (count > (uint32_t)max)
+	{
+		count = max;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		out[i] = ring->samples[(tail + i) & (TRACE_RING_CAPACITY - 1)];
+	}
+
+	__atomic_store_n(&ring->tail, tail + count, __ATOMIC_RELEASE);
+	return count;
+}
+
+#endif